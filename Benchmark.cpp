@@ -0,0 +1,330 @@
+// Throughput of every LNum operation and algorithm over operand sizes from 64 to 10⁶ bits.
+// Prints one row per (operation, size) as CSV, or a single JSON document with --json:
+//   op, bits, limbs, iterations, ops_per_sec, ns_per_op, ns_per_limb, allocs_per_op
+// Usage: Benchmark [--json] [--ops add,mul,...] [--max-bits N] [--min-time sec] [--max-op-time sec] [--seed N]
+// An operation stops growing once the next size is predicted to take over --max-op-time per call.
+// Operands come from a Xoshiro256 seeded with --seed, so runs with the same seed time the same numbers.
+// Built with LNUM_STATS=1 it also dumps the Stats snapshot of the whole run to stderr.
+#define BIGNUM_NO_MAIN
+#include "BignumArithmetic.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+// Every heap allocation goes through these replacements so it can be counted
+static atomic<uint64_t> allocations{ 0 };
+
+#if defined(__GNUC__) && !defined(__clang__)
+// They pair malloc with free, which GCC reports once they get inlined into new/delete expressions
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+// Swallows the "g^k used" lines encrypt prints
+class NullBuffer : public streambuf {
+protected:
+	int overflow(int c) override {
+		return c;
+	}
+};
+
+struct Options {
+	bool json = false;
+	vector<string> ops;
+	uint64_t max_bits = 1000000;
+	double min_time = 0.2;    // seconds spent on each (operation, size)
+	double max_op_time = 2.0; // larger sizes are skipped once a single call is expected to take longer
+	uint64_t seed = 1;
+};
+
+struct Result {
+	string op;
+	uint64_t bits, limbs, iterations;
+	double seconds;
+	uint64_t allocations;
+};
+
+// An operation prepares its operands for a size once, then run() is timed
+struct Case {
+	uint64_t bits, limbs;
+	function<void()> run;
+};
+
+struct Benchmark {
+	string name;
+	vector<uint64_t> sizes;
+	function<Case(uint64_t bits)> prepare;
+};
+
+// A uniformly random number of exactly `bits` bits
+LNum random_bits(uint64_t bits) {
+	const LNum low = LNum(1) << (bits - 1);
+	return low + LNum::random_below(low);
+}
+
+LNum random_odd(uint64_t bits) {
+	LNum x = random_bits(bits);
+	return x.is_odd() ? x : x + 1;
+}
+
+// Largest Mersenne prime 2ᵖ - 1 with p <= bits, so is_prime runs on a prime of about the requested size
+LNum mersenne_prime(uint64_t bits) {
+	uint64_t p = 61;
+	for (uint64_t e : { 89, 107, 127, 521, 607, 1279, 2203, 2281, 3217, 4253, 4423, 9689, 9941, 11213, 19937, 21701,
+		23209, 44497, 86243, 110503, 132049, 216091, 756839 })
+		if (e <= bits)
+			p = e;
+	return (LNum(1) << p) - 1;
+}
+
+Case make_case(const LNum& operand, function<void()> run) {
+	return { operand.bit_length(), operand.limbs(), move(run) };
+}
+
+vector<Benchmark> benchmarks() {
+	const vector<uint64_t> sizes = { 64, 256, 1024, 4096, 16384, 65536, 262144, 1000000 };
+	// A sink the optimizer can't see through
+	static LNum sink;
+
+	return {
+		{ "add", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), b = random_bits(bits);
+			return make_case(a, [=] { sink = a + b; });
+		} },
+		{ "sub", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), b = random_bits(bits - 1);
+			return make_case(a, [=] { sink = a - b; });
+		} },
+		{ "mul", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), b = random_bits(bits);
+			return make_case(a, [=] { sink = a * b; });
+		} },
+		{ "mulFur", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), b = random_bits(bits);
+			return make_case(a, [=] { sink = LNum::mulFur(a, b); });
+		} },
+		{ "div", sizes, [](uint64_t bits) {
+			LNum a = random_bits(2 * bits), b = random_bits(bits);
+			return make_case(b, [=] { sink = a / b; });
+		} },
+		{ "mod", sizes, [](uint64_t bits) {
+			LNum a = random_bits(2 * bits), b = random_bits(bits);
+			return make_case(b, [=] { sink = a % b; });
+		} },
+		{ "pow_mod", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), e = random_bits(bits), m = random_odd(bits);
+			return make_case(m, [=] { sink = a.pow_mod(e, m); });
+		} },
+		{ "sqrt", sizes, [](uint64_t bits) {
+			LNum a = random_bits(2 * bits);
+			return make_case(LNum::sqrt(a), [=] { sink = LNum::sqrt(a); });
+		} },
+		{ "to_str", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits);
+			return make_case(a, [=] { sink = a.to_str().size(); });
+		} },
+		{ "parse", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits);
+			string s = a.to_str();
+			return make_case(a, [=] { sink = LNum(s); });
+		} },
+		{ "gcd", sizes, [](uint64_t bits) {
+			LNum a = random_bits(bits), b = random_bits(bits);
+			return make_case(a, [=] { sink = gcd(a, b); });
+		} },
+		{ "is_prime", sizes, [](uint64_t bits) {
+			LNum p = mersenne_prime(bits);
+			return make_case(p, [=] { sink = p.is_prime(10); });
+		} },
+		// n = 1000003 * (2ᵖ - 1): rho finds the small factor, then the Mersenne cofactor has to be proven prime
+		{ "ro_pollard", sizes, [](uint64_t bits) {
+			LNum n = mersenne_prime(bits) * 1000003;
+			return make_case(n, [=] {
+				factor_cache().clear();
+				sink = ro_pollard(n).size();
+			});
+		} },
+		// The baby-step table holds √p entries, so the sizes stop where it still fits in memory
+		{ "babystep_giantstep", { 16, 24, 32, 40 }, [](uint64_t bits) {
+			uint64_t p = (uint64_t(1) << bits) - 1;
+			while (!is_prime(p))
+				p -= 2;
+			const uint64_t g = 3, h = ModU64(p).pow(g, ::random(1, p - 2));
+			return make_case(p, [=] { sink = babystep_giantstep(LNum(g), LNum(h), LNum(p)); });
+		} },
+		// gen_key draws the key from [10²⁰, q), so q starts at 128 bits. q is odd, as a prime modulus would be, so
+	// every run takes the same Montgomery path instead of depending on the parity of a random q
+		{ "encrypt", { 128, 256, 1024, 4096, 16384 }, [](uint64_t bits) {
+			LNum q = random_odd(bits), g = LNum::random(2, q), key = gen_key(q), h = g.pow_mod(key, q);
+			return make_case(q, [=] {
+				static NullBuffer null;
+				streambuf* out = cout.rdbuf(&null);
+				sink = get<1>(encrypt("Hello there!", q, h, g));
+				cout.rdbuf(out);
+			});
+		} },
+		{ "decrypt", { 128, 256, 1024, 4096, 16384 }, [](uint64_t bits) {
+			LNum q = random_odd(bits), g = LNum::random(2, q), key = gen_key(q), h = g.pow_mod(key, q);
+			LNum k = gen_key(q), s = h.pow_mod(k, q), p = g.pow_mod(k, q);
+			vector<LNum> en_msg;
+			for (char c : string("Hello there!"))
+				en_msg.push_back(s * c);
+			return make_case(q, [=] { sink = decrypt(en_msg, p, key, q).size(); });
+		} },
+		// The demo's path: both exponentiations in FixedNum<256>, so q has to stay below 2²⁵⁶
+		{ "encrypt<256>", { 128, 256 }, [](uint64_t bits) {
+			LNum q = random_odd(bits), g = LNum::random(2, q), key = gen_key(q), h = g.pow_mod(key, q);
+			return make_case(q, [=] {
+				static NullBuffer null;
+				streambuf* out = cout.rdbuf(&null);
+				sink = get<1>(encrypt<256>("Hello there!", q, h, g));
+				cout.rdbuf(out);
+			});
+		} },
+		{ "decrypt<256>", { 128, 256 }, [](uint64_t bits) {
+			LNum q = random_odd(bits), g = LNum::random(2, q), key = gen_key(q), h = g.pow_mod(key, q);
+			LNum k = gen_key(q), s = h.pow_mod(k, q), p = g.pow_mod(k, q);
+			vector<LNum> en_msg;
+			for (char c : string("Hello there!"))
+				en_msg.push_back(s * c);
+			return make_case(q, [=] { sink = decrypt<256>(en_msg, p, key, q).size(); });
+		} },
+	};
+}
+
+Result measure(const string& name, const Case& c, const Options& options) {
+	using clock = chrono::steady_clock;
+	Result res{ name, c.bits, c.limbs, 0, 0, 0 };
+	const uint64_t allocations_before = allocations.load();
+	const clock::time_point start = clock::now();
+	do {
+		c.run();
+		++res.iterations;
+		res.seconds = chrono::duration<double>(clock::now() - start).count();
+	} while (res.seconds < options.min_time);
+	res.allocations = allocations.load() - allocations_before;
+	return res;
+}
+
+void print_csv_header() {
+	cout << "op,bits,limbs,iterations,ops_per_sec,ns_per_op,ns_per_limb,allocs_per_op" << endl;
+}
+
+void print_csv(const Result& r) {
+	const double ns = r.seconds * 1e9 / r.iterations;
+	cout << r.op << ',' << r.bits << ',' << r.limbs << ',' << r.iterations << ',' << r.iterations / r.seconds << ','
+		<< ns << ',' << ns / r.limbs << ',' << double(r.allocations) / r.iterations << endl;
+}
+
+void print_json(const vector<Result>& results, uint64_t seed) {
+	cout << "{\n\t\"kernels\": \"" << LimbKernels::get().name << "\",\n\t\"seed\": " << seed << ",\n\t\"results\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		const double ns = r.seconds * 1e9 / r.iterations;
+		cout << (i ? ",\n" : "\n") << "\t\t{ \"op\": \"" << r.op << "\", \"bits\": " << r.bits << ", \"limbs\": " << r.limbs
+			<< ", \"iterations\": " << r.iterations << ", \"ops_per_sec\": " << r.iterations / r.seconds
+			<< ", \"ns_per_op\": " << ns << ", \"ns_per_limb\": " << ns / r.limbs
+			<< ", \"allocs_per_op\": " << double(r.allocations) / r.iterations << " }";
+	}
+	cout << "\n\t]\n}" << endl;
+}
+
+Options parse_options(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--json")
+			options.json = true;
+		else if (arg == "--ops" && has_value) {
+			stringstream list(argv[++i]);
+			for (string op; getline(list, op, ',');)
+				options.ops.push_back(op);
+		}
+		else if (arg == "--max-bits" && has_value)
+			options.max_bits = strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--min-time" && has_value)
+			options.min_time = atof(argv[++i]);
+		else if (arg == "--max-op-time" && has_value)
+			options.max_op_time = atof(argv[++i]);
+		else if (arg == "--seed" && has_value)
+			options.seed = strtoull(argv[++i], nullptr, 10);
+		else
+			throw invalid_argument("unknown option " + arg);
+	}
+	return options;
+}
+
+int main(int argc, char* argv[]) {
+	Options options;
+	try {
+		options = parse_options(argc, argv);
+	}
+	catch (invalid_argument& e) {
+		cerr << e.what() << "\nUsage: " << argv[0]
+			<< " [--json] [--ops add,mul,...] [--max-bits N] [--min-time sec] [--max-op-time sec] [--seed N]" << endl;
+		return 1;
+	}
+	RandomSource::use(make_unique<Xoshiro256Random>(options.seed));
+
+	vector<Result> results;
+	if (!options.json)
+		print_csv_header();
+	for (const Benchmark& b : benchmarks()) {
+		if (!options.ops.empty() && find(options.ops.begin(), options.ops.end(), b.name) == options.ops.end())
+			continue;
+		// Time per call grows as size^exponent, estimated from the last two sizes
+		double exponent = 1, last_bits = 0, last_time = 0;
+		for (uint64_t bits : b.sizes) {
+			if (bits > options.max_bits)
+				break;
+			if (last_time > 0 && last_time * std::pow(bits / last_bits, exponent) > options.max_op_time)
+				break;
+			const Result r = measure(b.name, b.prepare(bits), options);
+			if (options.json)
+				results.push_back(r);
+			else
+				print_csv(r);
+			const double time = r.seconds / r.iterations;
+			if (last_time > 0 && time > last_time)
+				exponent = max(1.0, log(time / last_time) / log(r.bits / last_bits));
+			last_bits = double(r.bits);
+			last_time = time;
+		}
+	}
+	if (options.json)
+		print_json(results, options.seed);
+#if LNUM_STATS
+	Stats::snapshot().write_json(cerr);
+#endif
+}
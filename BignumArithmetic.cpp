@@ -14,6 +14,30 @@
 #include <tuple>
 #include <random>
 #include <optional>
+#include <array>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#if LNUM_STATS
+#include <atomic>
+#include <chrono>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LIMB_SIMD 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LIMB_TARGET(isa)
+#else
+#include <immintrin.h>
+#define LIMB_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define LIMB_SIMD 0
+#endif
 
 
 using namespace std;
@@ -34,443 +58,1471 @@ uint64_t lg(uint64_t n) {
 	return n == 1 ? 0 : 1 + lg(n >> 1);
 }
 
-uint64_t sqr(uint64_t a) {
+constexpr uint64_t sqr(uint64_t a) {
 	return a * a;
 }
 
-uint64_t power(uint64_t a, uint64_t n) {
+constexpr uint64_t power(uint64_t a, uint64_t n) {
 	return n == 0 ? 1 : sqr(power(a, n / 2)) * (n % 2 == 0 ? 1 : a);
 }
 
-valarray<Complex> pow(valarray<Complex> a, int64_t power_) {
-	transform(begin(a), end(a), begin(a), [power_](Complex base) { return pow(base, power_); });
-	return a;
+// Low 64 bits of a * b, the high 64 bits go to hi
+constexpr uint64_t mul_wide(uint64_t a, uint64_t b, uint64_t& hi) {
+#ifdef __SIZEOF_INT128__
+	const unsigned __int128 r = (unsigned __int128)a * b;
+	hi = uint64_t(r >> 64);
+	return uint64_t(r);
+#else
+	const uint64_t a_lo = a & UINT32_MAX, a_hi = a >> 32;
+	const uint64_t b_lo = b & UINT32_MAX, b_hi = b >> 32;
+	const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	const uint64_t cross = (lo_lo >> 32) + (hi_lo & UINT32_MAX) + lo_hi;
+	hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+	return (cross << 32) | (lo_lo & UINT32_MAX);
+#endif
 }
 
-uint64_t random(uint64_t a = 0, uint64_t b = numeric_limits<uint64_t>::max()) {
-	auto tmp = mt19937(random_device()());
-	return uniform_int_distribution<mt19937::result_type>(a, b)(tmp);
+// t + a * b + carry, the high word of the sum goes back to carry
+constexpr uint64_t mul_add_wide(uint64_t t, uint64_t a, uint64_t b, uint64_t& carry) {
+	uint64_t hi = 0;
+	uint64_t lo = mul_wide(a, b, hi);
+	lo += t;
+	hi += lo < t;
+	lo += carry;
+	hi += lo < carry;
+	carry = hi;
+	return lo;
 }
-class LNumHasher;
 
-class LNum {
-	vector<uint64_t> parts;
-	const uint64_t base = std::pow(10, BASE_POWER);
-	uint64_t N, P;
-#if _DEBUG
-	string repr;
+// a * b mod m for any non-zero m
+constexpr uint64_t mul_mod_u64(uint64_t a, uint64_t b, uint64_t m) {
+#ifdef __SIZEOF_INT128__
+	return uint64_t((unsigned __int128)a * b % m);
+#else
+	uint64_t res = 0;
+	a %= m;
+	for (; b > 0; b >>= 1) {
+		if (b & 1)
+			res = res >= m - a ? res - (m - a) : res + a;
+		a = a >= m - a ? a - (m - a) : a + a;
+	}
+	return res;
 #endif
+}
+
+// Arithmetic modulo a single machine word. Odd moduli use Montgomery-64 form for exponentiation,
+// so the hot loop of pow is two 64x64 multiplications without any division.
+class ModU64 {
+	uint64_t m;
+	uint64_t m_inv = 0; // m⁻¹ mod 2⁶⁴, odd m only
+	uint64_t r2 = 0;    // 2¹²⁸ mod m, odd m only
+
+	// a * b / 2⁶⁴ mod m, a and b below m
+	uint64_t redc_mul(uint64_t a, uint64_t b) const {
+		uint64_t hi = 0, mhi = 0;
+		const uint64_t lo = mul_wide(a, b, hi);
+		mul_wide(lo * m_inv, m, mhi);
+		return hi >= mhi ? hi - mhi : hi - mhi + m;
+	}
+
 public:
-	LNum(string str) {
-		while (str.length() >= BASE_POWER) {
-			parts.push_back(stoull(str.substr(str.length() - BASE_POWER, BASE_POWER)));
-			str.erase(str.length() - BASE_POWER, BASE_POWER);
-		}
-		if (str.length() > 0) {
-			parts.push_back(stoull(str.substr(0, str.length())));
+	explicit ModU64(uint64_t m) : m(m) {
+		assert(m > 0);
+		if (m % 2 == 1) {
+			uint64_t inv = 1;
+			for (int i = 0; i < 6; ++i)
+				inv *= 2 - m * inv;
+			m_inv = inv;
+			const uint64_t r1 = (0 - m) % m;
+			r2 = mul_mod_u64(r1, r1, m);
 		}
-#if _DEBUG
-		repr = to_str();
-#endif
 	}
 
-	LNum(uint64_t i) : LNum(to_string(i)) {}
-
-	LNum(vector<uint64_t> parts) : parts(parts) {
-#if _DEBUG
-		repr = to_str();
-#endif
+	uint64_t modulus() const {
+		return m;
 	}
 
-	uint64_t bits() {
-		LNum var = *this;
-		uint64_t bits;
-		for (bits = 0; var != 0; ++bits) var /= 2;
-		return bits;
+	uint64_t add(uint64_t a, uint64_t b) const {
+		return a >= m - b ? a - (m - b) : a + b;
 	}
 
-	LNum& operator =(LNum other) {
-		if (&other == this)
-			return *this;
-		parts = other.parts;
-#if _DEBUG
-		repr = to_str();
-#endif
-		return *this;
+	uint64_t sub(uint64_t a, uint64_t b) const {
+		return a >= b ? a - b : a + (m - b);
 	}
 
-	LNum(const LNum& other) {
-		parts = other.parts;
-#if _DEBUG
-		repr = to_str();
-#endif
+	uint64_t mul(uint64_t a, uint64_t b) const {
+		return mul_mod_u64(a, b, m);
 	}
 
-	static LNum random(LNum from, LNum to) {
-		LNum diff = to - from;
-		vector<uint64_t> parts(diff.parts.size());
-		for_each(parts.begin(), prev(parts.end()), [](uint64_t& p) {
-			p = ::random(0, base_max());
-		});
-		uint8_t carry = parts.size() > 1 ? LNum(vector(diff.parts.begin(), prev(diff.parts.end()))) < LNum(vector(parts.begin(), prev(parts.end()))) : 0;
-		parts[parts.size() - 1] = ::random(0, diff.parts[parts.size() - 1] - carry);
-		remove_zeros(parts);
-		return from + LNum(parts);
+	uint64_t pow(uint64_t a, uint64_t exp) const {
+		a %= m;
+		if (m % 2 == 0) {
+			uint64_t res = 1 % m;
+			for (; exp > 0; exp >>= 1) {
+				if (exp & 1)
+					res = mul(res, a);
+				a = mul(a, a);
+			}
+			return res;
+		}
+		uint64_t x = redc_mul(a, r2);
+		uint64_t res = redc_mul(1 % m, r2);
+		for (; exp > 0; exp >>= 1) {
+			if (exp & 1)
+				res = redc_mul(res, x);
+			x = redc_mul(x, x);
+		}
+		return redc_mul(res, 1);
 	}
+};
 
-	LNum& operator +=(const LNum& rhs) {
-		*this = *this + rhs;
-		return *this;
+valarray<Complex> pow(valarray<Complex> a, int64_t power_) {
+	transform(begin(a), end(a), begin(a), [power_](Complex base) { return pow(base, power_); });
+	return a;
+}
+
+// Where random words come from. Every thread has its own generator, a ChaCha20 stream keyed from
+// random_device on first use; use() swaps it, e.g. for a seeded Xoshiro256 in reproducible tests.
+class RandomSource {
+	static unique_ptr<RandomSource>& current() {
+		static thread_local unique_ptr<RandomSource> source;
+		return source;
 	}
 
-	LNum operator+(const LNum& rhs) const {
-		LNum lhs = *this;
-		uint64_t carry = 0;
-		for (size_t i = 0; i < max(lhs.parts.size(), rhs.parts.size()) || carry; ++i) {
-			if (i == lhs.parts.size())
-				lhs.parts.push_back(0);
-			lhs.parts[i] += carry + (i < rhs.parts.size() ? rhs.parts[i] : 0);
-			carry = lhs.parts[i] >= base;
-			if (carry) lhs.parts[i] -= base;
-		}
-		return lhs;
+public:
+	virtual ~RandomSource() = default;
+
+	virtual void fill(uint64_t* out, size_t n) = 0;
+
+	uint64_t next() {
+		uint64_t x;
+		fill(&x, 1);
+		return x;
 	}
 
-	static LNum plus_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
-		return ((rhs % mod) + (lhs % mod)) % mod;
+	// Uniform in [a, b], rejecting the low words that would bias x % span
+	uint64_t uniform(uint64_t a, uint64_t b) {
+		const uint64_t span = b - a + 1;
+		if (span == 0)
+			return next();
+		const uint64_t threshold = (0 - span) % span;
+		uint64_t x;
+		do x = next(); while (x < threshold);
+		return a + x % span;
 	}
-	static LNum minus_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
-		return ((rhs % mod) - (lhs % mod)) % mod;
+
+	static RandomSource& local();
+
+	// Replaces the generator of the calling thread only
+	static void use(unique_ptr<RandomSource> source) {
+		current() = move(source);
 	}
-	static LNum mul_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
-		return ((rhs % mod) * (lhs % mod)) % mod;
+};
+
+// RFC 8439 ChaCha20 keystream with a zero nonce, 8 words per block
+class ChaCha20Random : public RandomSource {
+	uint32_t state[16];
+	uint64_t block[8];
+	size_t used = 8;
+
+	static uint32_t rotl(uint32_t x, int n) {
+		return (x << n) | (x >> (32 - n));
+	}
+
+	static void quarter_round(uint32_t* x, int a, int b, int c, int d) {
+		x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+		x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+		x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+		x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+	}
+
+	void refill() {
+		uint32_t x[16];
+		copy(begin(state), end(state), x);
+		for (int i = 0; i < 10; ++i) {
+			quarter_round(x, 0, 4, 8, 12);
+			quarter_round(x, 1, 5, 9, 13);
+			quarter_round(x, 2, 6, 10, 14);
+			quarter_round(x, 3, 7, 11, 15);
+			quarter_round(x, 0, 5, 10, 15);
+			quarter_round(x, 1, 6, 11, 12);
+			quarter_round(x, 2, 7, 8, 13);
+			quarter_round(x, 3, 4, 9, 14);
+		}
+		for (int i = 0; i < 8; ++i)
+			block[i] = uint64_t(x[2 * i] + state[2 * i]) | uint64_t(x[2 * i + 1] + state[2 * i + 1]) << 32;
+		if (++state[12] == 0)
+			++state[13];
+		used = 0;
 	}
-	static LNum div_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
-		return ((rhs % mod) / (lhs % mod)) % mod;
+
+public:
+	explicit ChaCha20Random(const array<uint32_t, 8>& key) {
+		const uint32_t sigma[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 }; // "expand 32-byte k"
+		copy(begin(sigma), end(sigma), state);
+		copy(key.begin(), key.end(), state + 4);
+		fill_n(state + 12, 4, 0);
+	}
+
+	ChaCha20Random() : ChaCha20Random(random_key()) {}
+
+	static array<uint32_t, 8> random_key() {
+		random_device device;
+		array<uint32_t, 8> key;
+		for (uint32_t& k : key)
+			k = device();
+		return key;
+	}
+
+	void fill(uint64_t* out, size_t n) override {
+		while (n > 0) {
+			if (used == 8)
+				refill();
+			const size_t take = min(n, 8 - used);
+			copy(block + used, block + used + take, out);
+			used += take;
+			out += take;
+			n -= take;
+		}
 	}
-	static LNum mod_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
-		return ((rhs % mod) % (lhs % mod)) % mod;
+};
+
+// xoshiro256**, fast and reproducible from a seed but not for keys
+class Xoshiro256Random : public RandomSource {
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int n) {
+		return (x << n) | (x >> (64 - n));
 	}
-	LNum pow_mod(LNum exp, LNum modulus) {
-		LNum base = *this;
-		base = base % modulus;
-		LNum result = 1;
-		while (exp > 0) {
-			if ((exp % 2) == 1) {
-				result = (result * base) % modulus;
-			}
 
-			base = (base * base) % modulus;
-			exp = exp / 2;
+public:
+	explicit Xoshiro256Random(uint64_t seed) {
+		// SplitMix64 spreads the seed over the state
+		for (uint64_t& word : s) {
+			uint64_t z = (seed += 0x9e3779b97f4a7c15);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			word = z ^ (z >> 31);
 		}
-		return result;
 	}
 
-	LNum& operator -=(const LNum& rhs) {
-		*this = *this - rhs;
-		return *this;
+	void fill(uint64_t* out, size_t n) override {
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = rotl(s[1] * 5, 7) * 9;
+			const uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+		}
 	}
+};
 
-	LNum operator-(const LNum& rhs) const {
-#if _DEBUG
-		assert(LNum(*this) >= rhs);
-#endif
-		LNum lhs = *this;
-		uint64_t carry = 0;
-		for (size_t i = 0; i < rhs.parts.size() || carry; ++i) {
-			uint64_t temp = carry + (i < rhs.parts.size() ? rhs.parts[i] : 0);
-			carry = lhs.parts[i] < temp;
-			if (carry) {
-#if _DEBUG
-				assert(base > temp);
-#endif
-				lhs.parts[i] += base - temp;
-			}
-			else {
-				lhs.parts[i] -= temp;
+RandomSource& RandomSource::local() {
+	unique_ptr<RandomSource>& source = current();
+	if (!source)
+		source = make_unique<ChaCha20Random>();
+	return *source;
+}
+
+uint64_t random(uint64_t a = 0, uint64_t b = numeric_limits<uint64_t>::max()) {
+	return RandomSource::local().uniform(a, b);
+}
+
+#if LNUM_STATS
+// Optional counters and latency histograms for long runs, compiled in with LNUM_STATS=1.
+// Each thread writes its own block, snapshot() sums all of them and can be called from any thread.
+// Operations nest: pow_mod's time includes the mul and mod calls it makes, which are recorded too.
+class Stats {
+public:
+	enum Op { ADD, SUB, MUL, MUL_WORD, MUL_ADD, SQR_ADD, DIV, MOD, MOD_WORD, POW_MOD, SQRT, GCD, PARSE, TO_STR, OP_COUNT };
+	enum Counter {
+		RHO_ITERATIONS, RHO_GCD_CALLS, MILLER_RABIN_ROUNDS, BSGS_TABLE_INSERTS, BSGS_GIANT_STEPS,
+		FACTOR_CACHE_HITS, FACTOR_CACHE_MISSES,
+		LIMB_POOL_REUSES, LIMB_HEAP_ALLOCATIONS, LIMB_HEAP_FREES, LIMB_HEAP_WORDS, // blocks behind LNum::parts
+		COUNTER_COUNT
+	};
+	// Bucket i counts calls that took [2ⁱ, 2ⁱ⁺¹) ns, the last one everything slower
+	static constexpr size_t BUCKETS = 36;
+
+	struct Snapshot {
+		struct OpStats {
+			uint64_t calls = 0, limbs = 0, ns = 0;
+			uint64_t latency[BUCKETS] = {};
+		};
+		OpStats ops[OP_COUNT];
+		uint64_t counters[COUNTER_COUNT] = {};
+
+		// What happened between an earlier snapshot and this one
+		Snapshot operator -(const Snapshot& earlier) const {
+			Snapshot res = *this;
+			for (size_t i = 0; i < OP_COUNT; ++i) {
+				res.ops[i].calls -= earlier.ops[i].calls;
+				res.ops[i].limbs -= earlier.ops[i].limbs;
+				res.ops[i].ns -= earlier.ops[i].ns;
+				for (size_t b = 0; b < BUCKETS; ++b)
+					res.ops[i].latency[b] -= earlier.ops[i].latency[b];
 			}
+			for (size_t i = 0; i < COUNTER_COUNT; ++i)
+				res.counters[i] -= earlier.counters[i];
+			return res;
+		}
 
+		void write_json(ostream& os) const {
+			os << "{\n\t\"ops\": {";
+			bool first = true;
+			for (size_t i = 0; i < OP_COUNT; ++i) {
+				if (ops[i].calls == 0)
+					continue;
+				os << (first ? "\n" : ",\n") << "\t\t\"" << op_name(Op(i)) << "\": { \"calls\": " << ops[i].calls
+					<< ", \"limbs\": " << ops[i].limbs << ", \"ns\": " << ops[i].ns << ", \"latency_log2_ns\": [";
+				for (size_t b = 0; b < BUCKETS; ++b)
+					os << (b ? ", " : "") << ops[i].latency[b];
+				os << "] }";
+				first = false;
+			}
+			os << "\n\t},\n\t\"counters\": {";
+			for (size_t i = 0; i < COUNTER_COUNT; ++i)
+				os << (i ? "," : "") << "\n\t\t\"" << counter_name(Counter(i)) << "\": " << counters[i];
+			os << "\n\t}\n}" << endl;
 		}
-		remove_zeros(lhs.parts);
+	};
 
-		return lhs;
+	static void count(Counter counter, uint64_t n = 1) {
+		if (!dead)
+			bump(local().counters[counter], n);
 	}
 
-	LNum& operator /=(const LNum& rhs) {
-		*this = *this / rhs;
-		return *this;
+	static void record(Op op, uint64_t limbs, uint64_t ns) {
+		if (dead)
+			return;
+		Block& block = local();
+		bump(block.calls[op], 1);
+		bump(block.limbs[op], limbs);
+		bump(block.ns[op], ns);
+		bump(block.latency[op][min<uint64_t>(ns ? lg(ns) : 0, BUCKETS - 1)], 1);
 	}
 
-	LNum operator /(const LNum& rhs) const {
-		LNum lhs = *this;
-		LNum res = 0;
-		res.parts.resize(lhs.parts.size());
-		LNum curValue = 0;
-		for (int64_t i = lhs.parts.size() - 1; i >= 0; i--) {
-			curValue = curValue * base;
-
-			curValue.parts[0] = lhs.parts[i];
-			// подбираем максимальное число x, такое что b * x <= curValue
-			int64_t x = 0;
-			int64_t l = 0, r = base;
-			while (l <= r) {
-				int64_t m = (l + r) >> 1;
-				LNum cur = rhs * m;
-				if (cur <= curValue) {
-					x = m;
-					l = m + 1;
-				}
-				else {
-					r = m - 1;
-				}
-			}
-			res.parts[i] = x;
-			curValue = curValue - rhs * LNum(x);
-		}
+	// Records one call of op from construction to the end of the scope
+	class Timer {
+		Op op;
+		uint64_t limbs;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-		remove_zeros(res.parts);
+	public:
+		Timer(Op op, uint64_t limbs) : op(op), limbs(limbs) {}
+		~Timer() {
+			record(op, limbs, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+		}
+		Timer(const Timer&) = delete;
+		Timer& operator =(const Timer&) = delete;
+	};
+
+	static Snapshot snapshot() {
+		Registry& reg = registry();
+		lock_guard<mutex> guard(reg.lock);
+		Snapshot res;
+		add(res, reg.retired);
+		for (Block* block : reg.live)
+			add(res, *block);
 		return res;
 	}
 
-	LNum& operator %=(const LNum& rhs) {
-		*this = *this % rhs;
-		return *this;
+	static const char* op_name(Op op) {
+		static const char* const names[OP_COUNT] = {
+			"add", "sub", "mul", "mul_word", "mul_add", "sqr_add", "div", "mod", "mod_word", "pow_mod", "sqrt", "gcd", "parse", "to_str"
+		};
+		return names[op];
 	}
 
-	LNum operator %(const LNum& rhs) const {
-		LNum lhs = *this;
-		LNum res = 0;
-		res.parts.resize(lhs.parts.size());
-		LNum curValue = 0;
-		for (ptrdiff_t i = lhs.parts.size() - 1; i >= 0; i--) {
-			curValue = curValue * base;
-
-			curValue.parts[0] = lhs.parts[i];
-			// подбираем максимальное число x, такое что b * x <= curValue
-			int64_t x = 0;
-			int64_t l = 0, r = base;
-			while (l <= r) {
-				int64_t m = (l + r) >> 1;
-				LNum cur = rhs * m;
-				if (cur <= curValue)
-				{
-					x = m;
-					l = m + 1;
-				}
-				else {
-					r = m - 1;
-				}
+	static const char* counter_name(Counter counter) {
+		static const char* const names[COUNTER_COUNT] = {
+			"rho_iterations", "rho_gcd_calls", "miller_rabin_rounds", "bsgs_table_inserts", "bsgs_giant_steps",
+			"factor_cache_hits", "factor_cache_misses",
+			"limb_pool_reuses", "limb_heap_allocations", "limb_heap_frees", "limb_heap_words"
+		};
+		return names[counter];
+	}
+
+private:
+	struct Block {
+		atomic<uint64_t> calls[OP_COUNT], limbs[OP_COUNT], ns[OP_COUNT], latency[OP_COUNT][BUCKETS];
+		atomic<uint64_t> counters[COUNTER_COUNT];
+	};
+
+	struct Registry {
+		mutex lock;
+		vector<Block*> live;
+		Block retired{}; // totals of the threads that have exited
+	};
+
+	// Registers this thread's block on first use and folds it into retired when the thread exits
+	struct Local {
+		Block* block = new Block();
+
+		Local() {
+			Registry& reg = registry();
+			lock_guard<mutex> guard(reg.lock);
+			reg.live.push_back(block);
+		}
+
+		~Local() {
+			Registry& reg = registry();
+			{
+				lock_guard<mutex> guard(reg.lock);
+				reg.live.erase(find(reg.live.begin(), reg.live.end(), block));
+				merge(reg.retired, *block);
 			}
-			res.parts[i] = x;
-			curValue -= rhs * LNum(x);
+			delete block;
+			dead = true;
 		}
+	};
 
-		return curValue;
+	static inline thread_local bool dead = false;
+
+	// Only the owning thread writes a block, so a relaxed load and store is enough
+	static void bump(atomic<uint64_t>& value, uint64_t n) {
+		value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
 	}
 
-	LNum& operator %=(const uint64_t& rhs) {
-		*this = *this % rhs;
-		return *this;
+	static Registry& registry() {
+		static Registry reg;
+		return reg;
 	}
 
-	int64_t operator %(const uint64_t& rhs) const {
-		LNum lhs = *this;
-		int64_t carry = 0;
-		for (int64_t i = (int64_t)lhs.parts.size() - 1; i >= 0; --i) {
-			int64_t cur = lhs.parts[i] + carry * 1ll * base;
-			lhs.parts[i] = int64_t(cur / rhs);
-			carry = int64_t(cur % rhs);
-		}
-		return carry;
+	static Block& local() {
+		static thread_local Local local;
+		return *local.block;
 	}
 
-	LNum& operator *=(const LNum& rhs) {
-		*this = *this * rhs;
-		return *this;
+	static void merge(Block& into, const Block& from) {
+		for (size_t i = 0; i < OP_COUNT; ++i) {
+			bump(into.calls[i], from.calls[i]);
+			bump(into.limbs[i], from.limbs[i]);
+			bump(into.ns[i], from.ns[i]);
+			for (size_t b = 0; b < BUCKETS; ++b)
+				bump(into.latency[i][b], from.latency[i][b]);
+		}
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+			bump(into.counters[i], from.counters[i]);
 	}
 
-	LNum operator *(const LNum& rhs) const {
-		LNum lhs = *this;
-		vector<uint64_t> c((lhs.parts.size() + rhs.parts.size()) * 2);
-		for (size_t i = 0; i < lhs.parts.size(); ++i)
-			for (size_t j = 0, carry = 0; j < rhs.parts.size() || carry; ++j) {
-				uint64_t cur = c[i + j] + lhs.parts[i] * 1ll * (j < (uint64_t)rhs.parts.size() ? rhs.parts[j] : 0) + carry;
-				c[i + j] = uint64_t(cur % base);
-				carry = uint64_t(cur / base);
-			}
-		remove_zeros(c);
-		lhs.parts = c;
-		return lhs;
+	static void add(Snapshot& into, const Block& from) {
+		for (size_t i = 0; i < OP_COUNT; ++i) {
+			into.ops[i].calls += from.calls[i];
+			into.ops[i].limbs += from.limbs[i];
+			into.ops[i].ns += from.ns[i];
+			for (size_t b = 0; b < BUCKETS; ++b)
+				into.ops[i].latency[b] += from.latency[i][b];
+		}
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+			into.counters[i] += from.counters[i];
 	}
+};
 
-	LNum& operator *=(const uint64_t& rhs) {
-		*this = *this * rhs;
-		return *this;
+#define STATS_COUNT(counter, n) Stats::count(Stats::counter, n)
+#define STATS_TIME(op, limbs) const Stats::Timer stats_timer(Stats::op, limbs)
+#else
+// Compiled out: the arguments are not even evaluated
+#define STATS_COUNT(counter, n)
+#define STATS_TIME(op, limbs)
+#endif
+
+template <typename T>
+struct HeapBlocks {
+	static T* allocate(size_t n) {
+		return new T[n];
 	}
+	static void deallocate(T* p, size_t) {
+		delete[] p;
+	}
+};
 
-	LNum operator *(const uint64_t& rhs) const {
-		LNum lhs = *this;
-		uint64_t carry = 0;
-		for (size_t i = 0; i < lhs.parts.size() || carry; ++i) {
-			if (i == lhs.parts.size())
-				lhs.parts.push_back(0);
-			uint64_t cur = carry + lhs.parts[i] * 1ll * rhs;
-			lhs.parts[i] = uint64_t(cur % base);
-			carry = uint64_t(cur / base);
-		}
-		remove_zeros(lhs.parts);
-		return lhs;
+// Vector with inline storage for the first Inline elements, spills to blocks from Blocks beyond that
+template <typename T, size_t Inline, typename Blocks = HeapBlocks<T>>
+class SmallVector {
+	static_assert(is_trivially_copyable_v<T>, "SmallVector holds trivially copyable elements only");
+
+	size_t size_ = 0;
+	size_t capacity_ = Inline;
+	T* data_ = inline_;
+	T inline_[Inline];
+
+	bool on_heap() const {
+		return data_ != inline_;
 	}
 
-	LNum& operator ^=(const LNum& rhs) {
-		*this = *this ^ rhs;
-		return *this;
+	void release() {
+		if (on_heap())
+			Blocks::deallocate(data_, capacity_);
 	}
 
-	LNum operator ^(const LNum& rhs) const {
-		LNum res = 1;
-		LNum cur = *this;
-		LNum temp = rhs;
-		while (temp != 0) {
-			if (temp % 2 == 1)
-				res *= cur;
-			cur *= cur;
-			temp /= 2;
-		}
-		return res;
+	void grow(size_t min_capacity) {
+		size_t capacity = next_pow2(max(min_capacity, capacity_ * 2));
+		T* data = Blocks::allocate(capacity);
+		copy(data_, data_ + size_, data);
+		release();
+		data_ = data;
+		capacity_ = capacity;
 	}
 
-	valarray<Complex> ComputeZeta() {
-		valarray<Complex> zeta(P);
-		for (uint64_t k = 0; k < P; ++k) {
-			zeta[k] = exp(1il * PI * ldouble(2 * k + 1) / ldouble(N));
-		}
-		return zeta;
+public:
+	typedef T value_type;
+	typedef T* iterator;
+	typedef const T* const_iterator;
+
+	SmallVector() {}
+
+	explicit SmallVector(size_t n, const T& value = T()) {
+		resize(n, value);
 	}
 
-	LNum& mulFur(LNum rhs) {
-		const uint64_t n = next_pow2(this->bits() + rhs.bits());
-		P = next_pow2(log2(n));
-		N = 2 * n / std::pow(P, 2);
+	template <typename It, typename = typename iterator_traits<It>::iterator_category>
+	SmallVector(It first, It last) {
+		reserve(distance(first, last));
+		for (; first != last; ++first)
+			data_[size_++] = *first;
+	}
 
-		auto x = exp(1il * PI / ldouble(P)) * exp(1il * PI / ldouble(P));
+	SmallVector(initializer_list<T> list) : SmallVector(list.begin(), list.end()) {}
 
-		valarray<Complex> dzeta = ComputeZeta();
+	SmallVector(const SmallVector& other) : SmallVector(other.begin(), other.end()) {}
 
-		auto a = half_fft(decompose(*this), dzeta);
-		auto a1 = compose(inv_half_fft(a, dzeta)).to_str();
-		auto b = half_fft(decompose(rhs), dzeta);
-		auto b1 = compose(inv_half_fft(b, dzeta)).to_str();
+	SmallVector(SmallVector&& other) noexcept {
+		*this = move(other);
+	}
 
-		vector<valarray<Complex>> c(N);
-		for (size_t i = 0; i < N; ++i) {
-			//c[i].resize(P);
-			//valarray<ldouble> f1(P);
-			//valarray<ldouble> f2(P);
-			//for (uint64_t j = 0; j < P; ++j) {
-			//	f1[j] = (a[i][j].real() * b[i][j].real() - a[i][j].imag() * b[i][j].imag()); //% (std::pow(2, n) + 1);
-			//	f2[j] = (a[i][j].real() * b[i][j].imag() + a[i][j].imag() * b[i][j].real());// % (std::pow(2, n) + 1);
-			//}
-			//transform(begin(f1), end(f1), begin(f2), begin(c[i]), [](ldouble da, ldouble db) {
-			//	return Complex(da, db);
-			//});
-			c[i] = a[i] * b[i];
-		}
+	~SmallVector() {
+		release();
+	}
 
-		*this = compose(inv_half_fft(c, dzeta));
+	SmallVector& operator =(const SmallVector& other) {
+		if (&other == this)
+			return *this;
+		size_ = 0;
+		reserve(other.size_);
+		copy(other.begin(), other.end(), data_);
+		size_ = other.size_;
 		return *this;
 	}
 
-	static LNum mulFur(LNum lhs, LNum rhs)
-	{
-		return lhs.mulFur(rhs);
+	SmallVector& operator =(SmallVector&& other) noexcept {
+		if (&other == this)
+			return *this;
+		if (!other.on_heap()) {
+			// Inline contents cannot be stolen, but fit into whatever we already own
+			copy(other.begin(), other.end(), data_);
+			size_ = other.size_;
+		}
+		else {
+			release();
+			data_ = other.data_;
+			size_ = other.size_;
+			capacity_ = other.capacity_;
+			other.data_ = other.inline_;
+			other.capacity_ = Inline;
+		}
+		other.size_ = 0;
+		return *this;
 	}
 
-	bool operator <(const LNum& rhs) {
-		if (parts.size() != rhs.parts.size())
-			return parts.size() < rhs.parts.size();
-		for (int64_t i = parts.size() - 1; i >= 0; --i)
-			if (parts[i] != rhs.parts[i])
-				return parts[i] < rhs.parts[i];
-		return false;
-	}
+	size_t size() const { return size_; }
+	size_t capacity() const { return capacity_; }
+	bool empty() const { return size_ == 0; }
 
-	bool operator >(const LNum& rhs) {
-		return !(*this <= rhs);
+	T* data() { return data_; }
+	const T* data() const { return data_; }
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + size_; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + size_; }
+
+	T& operator [](size_t i) { return data_[i]; }
+	const T& operator [](size_t i) const { return data_[i]; }
+
+	T& back() { return data_[size_ - 1]; }
+	const T& back() const { return data_[size_ - 1]; }
+
+	void reserve(size_t capacity) {
+		if (capacity > capacity_)
+			grow(capacity);
 	}
 
-	bool operator <=(const LNum& rhs) {
-		return *this < rhs || *this == rhs;
+	void resize(size_t n, const T& value = T()) {
+		reserve(n);
+		if (n > size_)
+			fill(data_ + size_, data_ + n, value);
+		size_ = n;
 	}
 
-	bool operator >=(const LNum& rhs) {
-		return !(*this < rhs);
+	void push_back(const T& value) {
+		if (size_ == capacity_)
+			grow(size_ + 1);
+		data_[size_++] = value;
 	}
 
-	bool operator == (const LNum& rhs) const {
-		if (parts.size() != rhs.parts.size())
-			return false;
-		for (int64_t i = parts.size() - 1; i >= 0; --i)
-			if (parts[i] != rhs.parts[i])
-				return false;
-		return true;
+	void pop_back() {
+		--size_;
 	}
 
-	bool operator != (const LNum& rhs) {
-		return !(*this == rhs);
+	void clear() {
+		size_ = 0;
 	}
 
-	friend ostream& operator<<(ostream& os, const LNum& dt);
+	void swap(SmallVector& other) noexcept {
+		if (on_heap() && other.on_heap()) {
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			std::swap(capacity_, other.capacity_);
+			return;
+		}
+		SmallVector tmp(move(other));
+		other = move(*this);
+		*this = move(tmp);
+	}
 
-	static LNum abs_sub(LNum lhs, LNum rhs) {
-		return lhs > rhs ? lhs - rhs : rhs - lhs;
+	bool operator ==(const SmallVector& rhs) const {
+		return equal(begin(), end(), rhs.begin(), rhs.end());
 	}
+};
 
-	// Miller–Rabin primality test
-	bool is_prime(int certainty) const {
-		if (*this == 1) return true;
-		if (LNum(2) == *this || LNum(3) == *this)
-			return true;
-		if (LNum(2) > * this || *this % 2 == 0)
-			return false;
+// Per-thread free lists of limb blocks, one per power-of-two capacity.
+// Blocks are recycled without going back to the global allocator; outside of a Scope only a few
+// blocks per size class are kept, inside one everything is kept until the outermost Scope ends.
+class LimbPool {
+	static constexpr size_t KEEP = 16;
 
-		LNum d = *this - 1;
-		int s = 0;
+	vector<uint64_t*> free_[sizeof(uint64_t) * CHAR_BIT];
+	size_t depth = 0;
 
-		while (d % 2 == 0) {
-			d /= 2;
-			s += 1;
-		}
+	static inline thread_local bool dead = false;
 
-		for (uint64_t i = 0; i < certainty; ++i) {
-			LNum a = LNum::random(2, *this - 3);
+	LimbPool() {}
 
-			LNum x = a.pow_mod(d, *this);
-			if (x == 1 || x == *this - 1)
-				continue;
+	~LimbPool() {
+		trim(0);
+		dead = true;
+	}
 
-			for (uint64_t r = 1; r < s; ++r) {
-				x = x.pow_mod(2, *this);
-				if (x == 1)
-					return false;
-				if (x == *this - 1)
-					break;
-			}
+	static LimbPool& local() {
+		static thread_local LimbPool pool;
+		return pool;
+	}
 
-			if (x != *this - 1)
-				return false;
+	void trim(size_t keep) {
+		for (auto& blocks : free_) {
+			while (blocks.size() > keep) {
+				STATS_COUNT(LIMB_HEAP_FREES, 1);
+				delete[] blocks.back();
+				blocks.pop_back();
+			}
 		}
-
-		return true;
 	}
 
-	static LNum sqrt(LNum x) {
-		LNum r = x;
-		LNum l = 0;
-		LNum res = 0;
-		while (l <= r)
+public:
+	// Keeps every block released on this thread until the outermost Scope is destroyed
+	class Scope {
+	public:
+		Scope() {
+			++local().depth;
+		}
+		~Scope() {
+			LimbPool& pool = local();
+			if (--pool.depth == 0)
+				pool.trim(KEEP);
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator =(const Scope&) = delete;
+	};
+
+	// n must be a power of two
+	static uint64_t* allocate(size_t n) {
+		if (!dead) {
+			auto& blocks = local().free_[lg(n)];
+			if (!blocks.empty()) {
+				STATS_COUNT(LIMB_POOL_REUSES, 1);
+				uint64_t* p = blocks.back();
+				blocks.pop_back();
+				return p;
+			}
+		}
+		STATS_COUNT(LIMB_HEAP_ALLOCATIONS, 1);
+		STATS_COUNT(LIMB_HEAP_WORDS, n);
+		return new uint64_t[n];
+	}
+
+	static void deallocate(uint64_t* p, size_t n) {
+		if (!dead) {
+			LimbPool& pool = local();
+			auto& blocks = pool.free_[lg(n)];
+			if (pool.depth > 0 || blocks.size() < KEEP) {
+				blocks.push_back(p);
+				return;
+			}
+		}
+		STATS_COUNT(LIMB_HEAP_FREES, 1);
+		delete[] p;
+	}
+};
+
+// Lane-parallel halves of the limb loops, picked once per process by CPUID.
+// Limbs are below 10⁹ < 2³⁰, so a 32x32->64 multiply (vpmuludq) is exact for limb * word and
+// AVX2 / AVX-512 do 4 / 8 of them per instruction. Carries are left to the caller, which
+// normalizes the whole run in a single pass.
+class LimbKernels {
+	static constexpr uint64_t base = power(10, BASE_POWER);
+
+	static void add_scalar(uint64_t* a, const uint64_t* b, size_t n) {
+		for (size_t i = 0; i < n; ++i)
+			a[i] += b[i];
+	}
+
+	static void sub_scalar(uint64_t* a, const uint64_t* b, size_t n) {
+		for (size_t i = 0; i < n; ++i)
+			a[i] += base - b[i];
+	}
+
+	static void mul_scalar(uint64_t* out, const uint64_t* a, size_t n, uint64_t w) {
+		for (size_t i = 0; i < n; ++i)
+			out[i] = a[i] * w;
+	}
+
+	static void mul_row_scalar(uint64_t* acc, const uint64_t* a, size_t n, uint64_t w) {
+		for (size_t i = 0; i < n; ++i)
+			acc[i] += a[i] * w;
+	}
+
+#if LIMB_SIMD
+	LIMB_TARGET("avx2")
+	static void add_avx2(uint64_t* a, const uint64_t* b, size_t n) {
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+			const __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+			_mm256_storeu_si256((__m256i*)(a + i), _mm256_add_epi64(x, y));
+		}
+		add_scalar(a + i, b + i, n - i);
+	}
+
+	LIMB_TARGET("avx2")
+	static void sub_avx2(uint64_t* a, const uint64_t* b, size_t n) {
+		const __m256i base_v = _mm256_set1_epi64x(base);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+			const __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+			_mm256_storeu_si256((__m256i*)(a + i), _mm256_sub_epi64(_mm256_add_epi64(x, base_v), y));
+		}
+		sub_scalar(a + i, b + i, n - i);
+	}
+
+	LIMB_TARGET("avx2")
+	static void mul_avx2(uint64_t* out, const uint64_t* a, size_t n, uint64_t w) {
+		const __m256i w_v = _mm256_set1_epi64x(w);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+			_mm256_storeu_si256((__m256i*)(out + i), _mm256_mul_epu32(x, w_v));
+		}
+		mul_scalar(out + i, a + i, n - i, w);
+	}
+
+	LIMB_TARGET("avx2")
+	static void mul_row_avx2(uint64_t* acc, const uint64_t* a, size_t n, uint64_t w) {
+		const __m256i w_v = _mm256_set1_epi64x(w);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+			const __m256i y = _mm256_loadu_si256((const __m256i*)(acc + i));
+			_mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi64(y, _mm256_mul_epu32(x, w_v)));
+		}
+		mul_row_scalar(acc + i, a + i, n - i, w);
+	}
+
+	LIMB_TARGET("avx512f")
+	static void add_avx512(uint64_t* a, const uint64_t* b, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m512i x = _mm512_loadu_si512(a + i);
+			const __m512i y = _mm512_loadu_si512(b + i);
+			_mm512_storeu_si512(a + i, _mm512_add_epi64(x, y));
+		}
+		add_scalar(a + i, b + i, n - i);
+	}
+
+	LIMB_TARGET("avx512f")
+	static void sub_avx512(uint64_t* a, const uint64_t* b, size_t n) {
+		const __m512i base_v = _mm512_set1_epi64(base);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m512i x = _mm512_loadu_si512(a + i);
+			const __m512i y = _mm512_loadu_si512(b + i);
+			_mm512_storeu_si512(a + i, _mm512_sub_epi64(_mm512_add_epi64(x, base_v), y));
+		}
+		sub_scalar(a + i, b + i, n - i);
+	}
+
+	// _mm512_mul_epu32 merges into _mm512_undefined_epi32(), which GCC 12 reports as maybe-uninitialized;
+	// the all-lanes zero-masked form is the same vpmuludq without it
+	LIMB_TARGET("avx512f")
+	static __m512i mul_epu32_avx512(__m512i x, __m512i y) {
+		return _mm512_maskz_mul_epu32(__mmask8(0xFF), x, y);
+	}
+
+	LIMB_TARGET("avx512f")
+	static void mul_avx512(uint64_t* out, const uint64_t* a, size_t n, uint64_t w) {
+		const __m512i w_v = _mm512_set1_epi64(w);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m512i x = _mm512_loadu_si512(a + i);
+			_mm512_storeu_si512(out + i, mul_epu32_avx512(x, w_v));
+		}
+		mul_scalar(out + i, a + i, n - i, w);
+	}
+
+	LIMB_TARGET("avx512f")
+	static void mul_row_avx512(uint64_t* acc, const uint64_t* a, size_t n, uint64_t w) {
+		const __m512i w_v = _mm512_set1_epi64(w);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m512i x = _mm512_loadu_si512(a + i);
+			const __m512i y = _mm512_loadu_si512(acc + i);
+			_mm512_storeu_si512(acc + i, _mm512_add_epi64(y, mul_epu32_avx512(x, w_v)));
+		}
+		mul_row_scalar(acc + i, a + i, n - i, w);
+	}
+
+	// feature: bit of CPUID.7.0:EBX, xcr0: register state the OS has to save for it
+	static bool cpu_supports(int feature, [[maybe_unused]] uint64_t xcr0) {
+#ifdef _MSC_VER
+		int r[4];
+		__cpuid(r, 0);
+		if (r[0] < 7)
+			return false;
+		__cpuid(r, 1);
+		if (!(r[2] & (1 << 27)) || (_xgetbv(0) & xcr0) != xcr0)
+			return false;
+		__cpuidex(r, 7, 0);
+		return (r[1] >> feature) & 1;
+#else
+		__builtin_cpu_init();
+		return feature == 16 ? __builtin_cpu_supports("avx512f") : __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	static LimbKernels select() {
+#if LIMB_SIMD
+		if (cpu_supports(16, 0xE6))
+			return { add_avx512, sub_avx512, mul_avx512, mul_row_avx512, "avx512" };
+		if (cpu_supports(5, 0x6))
+			return { add_avx2, sub_avx2, mul_avx2, mul_row_avx2, "avx2" };
+#endif
+		return { add_scalar, sub_scalar, mul_scalar, mul_row_scalar, "scalar" };
+	}
+
+public:
+	void (*add)(uint64_t* a, const uint64_t* b, size_t n);                    // a[i] += b[i]
+	void (*sub)(uint64_t* a, const uint64_t* b, size_t n);                    // a[i] += 10⁹ - b[i]
+	void (*mul)(uint64_t* out, const uint64_t* a, size_t n, uint64_t w);      // out[i] = a[i] * w, w < 2³², out may be a
+	void (*mul_row)(uint64_t* acc, const uint64_t* a, size_t n, uint64_t w);  // acc[i] += a[i] * w, w < 2³²
+	const char* name;
+
+	static const LimbKernels& get() {
+		static const LimbKernels kernels = select();
+		return kernels;
+	}
+};
+
+class LNumHasher;
+template <size_t Bits> class FixedNum;
+
+class LNum {
+public:
+	// 8 limbs of 10⁹ cover values up to ~2²³⁹ without touching the heap
+	typedef SmallVector<uint64_t, 8, LimbPool> Limbs;
+	static constexpr uint64_t base = power(10, BASE_POWER);
+
+private:
+	Limbs parts;
+#if _DEBUG
+	// Filled lazily by to_str(), cleared whenever the value is rebuilt
+	mutable string repr;
+	mutable bool repr_fresh = false;
+#endif
+
+	// One distinct fft(w, n) call of the recursion. Every call with the same root shares its twiddles and
+	// scratch rows, so they are built once per plan; the two halves of the split are the child nodes.
+	struct FftNode {
+		uint64_t n, J = 0, K = 0;
+		vector<valarray<Complex>> twiddles;  // w^(j·k) at j·K + k
+		vector<vector<valarray<Complex>>> c; // K columns of J rows
+		vector<valarray<Complex>> d;         // K rows
+		unique_ptr<FftNode> inner, outer;    // fft(w², J) and fft(w^J, K)
+
+		FftNode(uint64_t P, const valarray<Complex>& w, uint64_t n) : n(n) {
+			if (n <= 2)
+				return;
+			J = (n <= 2 * P) ? 2 : 2 * P;
+			K = n / J;
+			c.assign(K, vector<valarray<Complex>>(J));
+			d.resize(K);
+			twiddles.reserve(J * K);
+			for (uint64_t j = 0; j < J; ++j)
+				for (uint64_t k = 0; k < K; ++k)
+					twiddles.push_back(::pow(w, j * k));
+			inner = make_unique<FftNode>(P, ::pow(w, 2), J);
+			outer = make_unique<FftNode>(P, ::pow(w, J), K);
+		}
+	};
+
+	// Parameters of one mulFur call and the tables all of its transforms share, kept off the number itself
+	struct FftPlan {
+		uint64_t N, P;
+		valarray<Complex> dzeta;
+		vector<valarray<Complex>> zeta_pow, inv_zeta_pow; // dzeta^k and dzeta^-k for k < N
+		unique_ptr<FftNode> forward, inverse;             // fft over dzeta² and dzeta⁻²
+
+		FftPlan(uint64_t N, uint64_t P) : N(N), P(P), dzeta(ComputeZeta(N, P)) {
+			zeta_pow.reserve(N);
+			inv_zeta_pow.reserve(N);
+			for (uint64_t k = 0; k < N; ++k) {
+				zeta_pow.push_back(::pow(dzeta, k));
+				inv_zeta_pow.push_back(::pow(dzeta, -int64_t(k)));
+			}
+			const valarray<Complex> w = ::pow(dzeta, 2);
+			forward = make_unique<FftNode>(P, w, N);
+			inverse = make_unique<FftNode>(P, ::pow(w, -1), N);
+		}
+	};
+
+	void changed() {
+#if _DEBUG
+		repr_fresh = false;
+#endif
+	}
+
+public:
+	LNum(string str) {
+		STATS_TIME(PARSE, (str.length() + BASE_POWER - 1) / BASE_POWER);
+		parts.reserve((str.length() + BASE_POWER - 1) / BASE_POWER);
+		while (str.length() >= BASE_POWER) {
+			parts.push_back(stoull(str.substr(str.length() - BASE_POWER, BASE_POWER)));
+			str.erase(str.length() - BASE_POWER, BASE_POWER);
+		}
+		if (str.length() > 0) {
+			parts.push_back(stoull(str.substr(0, str.length())));
+		}
+	}
+
+	LNum(uint64_t i) {
+		do {
+			parts.push_back(i % base);
+			i /= base;
+		} while (i > 0);
+	}
+
+	LNum(Limbs parts) : parts(move(parts)) {}
+
+	LNum(const vector<uint64_t>& parts) : parts(parts.begin(), parts.end()) {}
+
+	LNum& operator =(const LNum& other) {
+		if (&other == this)
+			return *this;
+		parts = other.parts;
+		changed();
+		return *this;
+	}
+
+	LNum& operator =(LNum&& other) noexcept {
+		parts = move(other.parts);
+		changed();
+		return *this;
+	}
+
+	LNum(const LNum& other) : parts(other.parts) {}
+
+	LNum(LNum&& other) noexcept : parts(move(other.parts)) {}
+
+	// Uniform in [from, to]
+	static LNum random(const LNum& from, const LNum& to, RandomSource& source = RandomSource::local()) {
+		return from + random_below(to - from + 1, source);
+	}
+
+	// Uniform in [0, 2ⁿ)
+	static LNum random_bits(uint64_t n, RandomSource& source = RandomSource::local()) {
+		return random_below(LNum(1) << n, source);
+	}
+
+	// Uniform in [0, bound), bound > 0. The lower limbs come from one bulk fill, the top one is drawn
+	// up to the top limb of bound, and whole candidates >= bound are rejected (less than half of them).
+	static LNum random_below(const LNum& bound, RandomSource& source = RandomSource::local()) {
+		assert(!bound.is_zero());
+		const size_t n = bound.parts.size();
+		LNum res;
+		res.parts.resize(n);
+		do {
+			random_limbs(res.parts.data(), n - 1, source);
+			res.parts[n - 1] = source.uniform(0, bound.parts[n - 1]);
+		} while (compare_limbs(res.parts, bound.parts) >= 0);
+		remove_zeros(res.parts);
+		return res;
+	}
+
+	LNum& operator +=(const LNum& rhs) {
+		STATS_TIME(ADD, max(parts.size(), rhs.parts.size()));
+		add_limbs(parts, rhs.parts);
+		changed();
+		return *this;
+	}
+
+	LNum operator+(const LNum& rhs) const& {
+		LNum lhs = *this;
+		lhs += rhs;
+		return lhs;
+	}
+
+	LNum operator+(const LNum& rhs)&& {
+		*this += rhs;
+		return move(*this);
+	}
+
+	static LNum plus_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
+		return ModU64(mod).add(rhs % mod, lhs % mod);
+	}
+	static LNum minus_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
+		return ModU64(mod).sub(rhs % mod, lhs % mod);
+	}
+	static LNum mul_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
+		return ModU64(mod).mul(rhs % mod, lhs % mod);
+	}
+	static LNum div_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
+		return (rhs % mod) / (lhs % mod) % mod;
+	}
+	static LNum mod_mod(const LNum& rhs, const LNum& lhs, uint64_t mod) {
+		return (rhs % mod) % (lhs % mod) % mod;
+	}
+	LNum pow_mod(LNum exp, const LNum& modulus) const {
+		STATS_TIME(POW_MOD, modulus.parts.size());
+		if (modulus.fits_u64()) {
+			const ModU64 mod(modulus.to_int());
+			const uint64_t a = *this % mod.modulus();
+			if (exp.fits_u64())
+				return mod.pow(a, exp.to_int());
+			// a^(e₁·base + e₀) = (a^e₁)^base · a^e₀, one decimal limb at a time
+			uint64_t res = 1 % mod.modulus();
+			for (int64_t i = exp.parts.size() - 1; i >= 0; --i)
+				res = mod.mul(mod.pow(res, base), mod.pow(a, exp.parts[i]));
+			return res;
+		}
+
+		LNum base = *this % modulus;
+		LNum result = 1;
+		while (!exp.is_zero()) {
+			if (exp.is_odd()) {
+				result *= base;
+				result %= modulus;
+			}
+
+			base *= base;
+			base %= modulus;
+			exp >>= 1;
+		}
+		return result;
+	}
+
+	LNum& operator -=(const LNum& rhs) {
+		STATS_TIME(SUB, parts.size());
+#if _DEBUG
+		assert(*this >= rhs);
+#endif
+		sub_limbs(parts, rhs.parts);
+		changed();
+		return *this;
+	}
+
+	LNum operator-(const LNum& rhs) const& {
+		LNum lhs = *this;
+		lhs -= rhs;
+		return lhs;
+	}
+
+	LNum operator-(const LNum& rhs)&& {
+		*this -= rhs;
+		return move(*this);
+	}
+
+	LNum& operator /=(const LNum& rhs) {
+		STATS_TIME(DIV, parts.size());
+		Limbs& quot = scratch(SCRATCH_PROD);
+		divmod_limbs(parts, rhs.parts, &quot, scratch(SCRATCH_REM));
+		parts.swap(quot);
+		changed();
+		return *this;
+	}
+
+	LNum operator /(const LNum& rhs) const {
+		STATS_TIME(DIV, parts.size());
+		LNum res;
+		divmod_limbs(parts, rhs.parts, &res.parts, scratch(SCRATCH_REM));
+		return res;
+	}
+
+	LNum& operator %=(const LNum& rhs) {
+		STATS_TIME(MOD, parts.size());
+		Limbs& rem = scratch(SCRATCH_REM);
+		divmod_limbs(parts, rhs.parts, nullptr, rem);
+		parts.swap(rem);
+		changed();
+		return *this;
+	}
+
+	LNum operator %(const LNum& rhs) const {
+		STATS_TIME(MOD, parts.size());
+		LNum res;
+		divmod_limbs(parts, rhs.parts, nullptr, res.parts);
+		return res;
+	}
+
+	LNum& operator %=(const uint64_t& rhs) {
+		*this = *this % rhs;
+		return *this;
+	}
+
+	uint64_t operator %(const uint64_t& rhs) const {
+		STATS_TIME(MOD_WORD, parts.size());
+		if (base % rhs == 0)
+			return parts.empty() ? 0 : parts[0] % rhs;
+		uint64_t carry = 0;
+		for (int64_t i = (int64_t)parts.size() - 1; i >= 0; --i) {
+			carry = mul_mod_u64(carry, base, rhs) + parts[i] % rhs;
+			if (carry >= rhs || carry < parts[i] % rhs)
+				carry -= rhs;
+		}
+		return carry;
+	}
+
+	LNum& operator *=(const LNum& rhs) {
+		STATS_TIME(MUL, parts.size() + rhs.parts.size());
+		Limbs& prod = scratch(SCRATCH_PROD);
+		mul_limbs(prod, parts, rhs.parts);
+		parts.swap(prod);
+		changed();
+		return *this;
+	}
+
+	LNum operator *(const LNum& rhs) const {
+		STATS_TIME(MUL, parts.size() + rhs.parts.size());
+		LNum res;
+		mul_limbs(res.parts, parts, rhs.parts);
+		return res;
+	}
+
+	LNum& operator *=(const uint64_t& rhs) {
+		STATS_TIME(MUL_WORD, parts.size());
+		if (parts.size() >= CARRY_SAVE_LIMBS && rhs <= UINT32_MAX) {
+			LimbKernels::get().mul(parts.data(), parts.data(), parts.size(), rhs);
+			normalize_limbs(parts, 0, parts.size());
+			remove_zeros(parts);
+			changed();
+			return *this;
+		}
+		uint64_t carry = 0;
+		for (size_t i = 0; i < parts.size() || carry; ++i) {
+			if (i == parts.size())
+				parts.push_back(0);
+			uint64_t cur = carry + parts[i] * 1ll * rhs;
+			parts[i] = uint64_t(cur % base);
+			carry = uint64_t(cur / base);
+		}
+		remove_zeros(parts);
+		changed();
+		return *this;
+	}
+
+	LNum operator *(const uint64_t& rhs) const& {
+		LNum lhs = *this;
+		lhs *= rhs;
+		return lhs;
+	}
+
+	LNum operator *(const uint64_t& rhs)&& {
+		*this *= rhs;
+		return move(*this);
+	}
+
+	// *this += a * b without materializing the product
+	LNum& mul_add(const LNum& a, const LNum& b) {
+		STATS_TIME(MUL_ADD, a.parts.size() + b.parts.size());
+		if (&a == this || &b == this || min(a.parts.size(), b.parts.size()) >= KARATSUBA_LIMBS) {
+			Limbs& prod = scratch(SCRATCH_PROD);
+			mul_limbs(prod, a.parts, b.parts);
+			add_limbs(parts, prod);
+		}
+		else {
+			mul_acc_limbs(parts, a.parts, b.parts);
+		}
+		changed();
+		return *this;
+	}
+
+	// *this = x * x + c, x and c may alias *this
+	LNum& sqr_add(const LNum& x, const LNum& c) {
+		STATS_TIME(SQR_ADD, 2 * x.parts.size());
+		Limbs& prod = scratch(SCRATCH_PROD);
+		mul_limbs(prod, x.parts, x.parts);
+		add_limbs(prod, c.parts);
+		parts.swap(prod);
+		changed();
+		return *this;
+	}
+
+	LNum& operator ^=(const LNum& rhs) {
+		*this = *this ^ rhs;
+		return *this;
+	}
+
+	LNum operator ^(const LNum& rhs) const {
+		LNum res = 1;
+		LNum cur = *this;
+		LNum temp = rhs;
+		while (!temp.is_zero()) {
+			if (temp.is_odd())
+				res *= cur;
+			cur *= cur;
+			temp >>= 1;
+		}
+		return res;
+	}
+
+	// Bit operations. base = 10⁹ = 2⁹·5⁹, so base^k is a multiple of 2^(9k): the low b bits of a number depend
+	// only on its low ⌈b/9⌉ limbs, and low_words reads them without touching the rest. Shifts past one word
+	// multiply or divide by 2^k, and &, | and bit_xor convert to binary by splitting at powers of two, all
+	// O(M(n)) to O(M(n)·log n) on top of Karatsuba and Newton division.
+
+	// Number of base 10⁹ digits
+	size_t limbs() const {
+		return parts.size();
+	}
+
+	bool is_zero() const {
+		return parts.empty() || (parts.size() == 1 && parts[0] == 0);
+	}
+
+	bool is_odd() const {
+		return !parts.empty() && (parts[0] & 1);
+	}
+
+	// O(1) below bit 9, O(i²) from the low limbs up to bit 9·KARATSUBA_LIMBS, O(M(n)) above
+	bool test_bit(uint64_t i) const {
+		if (i < LOW_BITS)
+			return !parts.empty() && ((parts[0] >> i) & 1);
+		if (i / LOW_BITS < KARATSUBA_LIMBS)
+			return (low_words(i / LOW_BITS + 1, i + 1)[i / 64] >> i % 64) & 1;
+		return (*this >> i).is_odd();
+	}
+
+	// O(1) from the top two limbs t, which put the number in [t·base^m, (t + 1)·base^m). The estimate is
+	// taken in double, whose 53 bits are all C++ promises; only when a power of two 2^k lies within its
+	// rounding of that interval, as it does for 2^k and 2^k - 1 themselves, is the number compared with 2^k
+	// exactly, which costs building 2^k: O(M(n)).
+	uint64_t bit_length() const {
+		if (is_zero())
+			return 0;
+		const size_t m = parts.size() - min<size_t>(parts.size(), 2);
+		const uint64_t t = (parts.size() > 1 ? parts[m + 1] * base : 0) + parts[m];
+		if (m == 0) {
+			uint64_t bits = 0;
+			for (uint64_t top = t; top != 0; top >>= 1) ++bits;
+			return bits;
+		}
+
+		const double scale = double(m * BASE_POWER) * log2(10.0), error = (scale + 64) * 1e-13;
+		const uint64_t lo = uint64_t(log2(double(t)) + scale - error), hi = uint64_t(log2(double(t + 1)) + scale + error);
+		if (lo == hi)
+			return hi + 1;
+		return *this >= (LNum(1) << hi) ? hi + 1 : hi;
+	}
+
+	// O(z²) from the low limbs for z trailing zeros, whatever the length of the number
+	uint64_t count_trailing_zeros() const {
+		if (is_zero())
+			return 0;
+		for (size_t count = 1;; count *= 2) {
+			const vector<uint64_t> words = low_words(count, count * LOW_BITS);
+			for (size_t i = 0; i < words.size(); ++i)
+				if (words[i] != 0) {
+					uint64_t zeros = 64 * i;
+					for (uint64_t low = words[i]; low % 2 == 0; low >>= 1) ++zeros;
+					return zeros;
+				}
+		}
+	}
+
+	LNum& operator >>=(uint64_t shift) {
+		if (shift > 64 * NEWTON_LIMBS)
+			return *this /= pow2(shift);
+		for (; shift > 0 && !is_zero(); shift -= min<uint64_t>(shift, 32))
+			shr_small(unsigned(min<uint64_t>(shift, 32)));
+		changed();
+		return *this;
+	}
+
+	LNum operator >>(uint64_t shift) const {
+		LNum res = *this;
+		res >>= shift;
+		return res;
+	}
+
+	LNum& operator <<=(uint64_t shift) {
+		if (shift > 64)
+			return *this *= pow2(shift);
+		for (; shift > 0; shift -= min<uint64_t>(shift, 32))
+			*this *= uint64_t(1) << min<uint64_t>(shift, 32);
+		return *this;
+	}
+
+	LNum operator <<(uint64_t shift) const {
+		LNum res = *this;
+		res <<= shift;
+		return res;
+	}
+
+	LNum& operator &=(const LNum& rhs) {
+		return *this = bitwise(*this, rhs, [](uint64_t a, uint64_t b) { return a & b; });
+	}
+
+	LNum operator &(const LNum& rhs) const {
+		return bitwise(*this, rhs, [](uint64_t a, uint64_t b) { return a & b; });
+	}
+
+	LNum& operator |=(const LNum& rhs) {
+		return *this = bitwise(*this, rhs, [](uint64_t a, uint64_t b) { return a | b; });
+	}
+
+	LNum operator |(const LNum& rhs) const {
+		return bitwise(*this, rhs, [](uint64_t a, uint64_t b) { return a | b; });
+	}
+
+	// ^ is already exponentiation. &, | and bit_xor are O(M(n)·log n), see above
+	LNum bit_xor(const LNum& rhs) const {
+		return bitwise(*this, rhs, [](uint64_t a, uint64_t b) { return a ^ b; });
+	}
+
+	LNum& mulFur(LNum rhs) {
+		const uint64_t n = next_pow2(this->bit_length() + rhs.bit_length());
+		const uint64_t P = next_pow2(log2(n));
+		FftPlan plan(2 * n / std::pow(P, 2), P);
+
+		auto a = half_fft(plan, decompose(plan, *this));
+		auto b = half_fft(plan, decompose(plan, rhs));
+
+		for (size_t i = 0; i < plan.N; ++i) {
+			//c[i].resize(P);
+			//valarray<ldouble> f1(P);
+			//valarray<ldouble> f2(P);
+			//for (uint64_t j = 0; j < P; ++j) {
+			//	f1[j] = (a[i][j].real() * b[i][j].real() - a[i][j].imag() * b[i][j].imag()); //% (std::pow(2, n) + 1);
+			//	f2[j] = (a[i][j].real() * b[i][j].imag() + a[i][j].imag() * b[i][j].real());// % (std::pow(2, n) + 1);
+			//}
+			//transform(begin(f1), end(f1), begin(f2), begin(c[i]), [](ldouble da, ldouble db) {
+			//	return Complex(da, db);
+			//});
+			a[i] *= b[i];
+		}
+
+		*this = compose(plan, inv_half_fft(plan, move(a)));
+		return *this;
+	}
+
+	static LNum mulFur(LNum lhs, LNum rhs)
+	{
+		return lhs.mulFur(rhs);
+	}
+
+	bool operator <(const LNum& rhs) const {
+		return compare_limbs(parts, rhs.parts) < 0;
+	}
+
+	bool operator >(const LNum& rhs) const {
+		return !(*this <= rhs);
+	}
+
+	bool operator <=(const LNum& rhs) const {
+		return *this < rhs || *this == rhs;
+	}
+
+	bool operator >=(const LNum& rhs) const {
+		return !(*this < rhs);
+	}
+
+	bool operator == (const LNum& rhs) const {
+		if (parts.size() != rhs.parts.size())
+			return false;
+		for (int64_t i = parts.size() - 1; i >= 0; --i)
+			if (parts[i] != rhs.parts[i])
+				return false;
+		return true;
+	}
+
+	bool operator != (const LNum& rhs) const {
+		return !(*this == rhs);
+	}
+
+	friend ostream& operator<<(ostream& os, const LNum& dt);
+
+	static LNum abs_sub(const LNum& lhs, const LNum& rhs) {
+		return lhs > rhs ? lhs - rhs : rhs - lhs;
+	}
+
+	// Miller–Rabin primality test
+	bool is_prime(int certainty) const {
+		LimbPool::Scope scope;
+		if (*this == 1) return true;
+		if (LNum(2) == *this || LNum(3) == *this)
+			return true;
+		if (LNum(2) > * this || !is_odd())
+			return false;
+
+		const LNum n_1 = *this - 1;
+		const uint64_t s = n_1.count_trailing_zeros();
+		const LNum d = n_1 >> s;
+
+		for (uint64_t i = 0; i < certainty; ++i) {
+			STATS_COUNT(MILLER_RABIN_ROUNDS, 1);
+			LNum a = LNum::random(2, *this - 3);
+
+			LNum x = a.pow_mod(d, *this);
+			if (x == 1 || x == n_1)
+				continue;
+
+			for (uint64_t r = 1; r < s; ++r) {
+				x *= x;
+				x %= *this;
+				if (x == 1)
+					return false;
+				if (x == n_1)
+					break;
+			}
+
+			if (x != n_1)
+				return false;
+		}
+
+		return true;
+	}
+
+	static LNum sqrt(LNum x) {
+		STATS_TIME(SQRT, x.parts.size());
+		LNum r = min(x, LNum(1) << (x.bit_length() + 1) / 2);
+		LNum l = 0;
+		LNum res = 0;
+		while (l <= r)
 		{
-			LNum m = (l + r) / 2;
+			LNum m = (l + r) >> 1;
 			if (m * m <= x)
 			{
 				res = m;
@@ -484,6 +1536,7 @@ public:
 	}
 
 	string to_str() const {
+		STATS_TIME(TO_STR, parts.size());
 		string res;
 		char buff[BASE_POWER + 1];
 		snprintf(buff, sizeof(buff), "%llu", parts.empty() ? 0 : parts.back());
@@ -492,31 +1545,512 @@ public:
 			snprintf(buff, sizeof(buff), ("%0" + to_string(BASE_POWER) + "llu").c_str(), parts[i]);
 			res += buff;
 		}
+#if _DEBUG
+		repr = res;
+		repr_fresh = true;
+#endif
 		return res;
 	}
 
+	bool fits_u64() const {
+		static const LNum max_u64(numeric_limits<uint64_t>::max());
+		return *this <= max_u64;
+	}
+
 	uint64_t to_int() const {
-		if (LNum(numeric_limits<uint64_t>::max()) >= *this) {
-			return stoull(this->to_str());
-		}
-		else {
-			throw;
-		}
+		if (!fits_u64())
+			throw out_of_range("LNum does not fit into uint64_t");
+		uint64_t res = 0;
+		for (int64_t i = parts.size() - 1; i >= 0; --i)
+			res = res * base + parts[i];
+		return res;
+	}
+
+	// Raw limbs: their count, then the limbs themselves in host byte order
+	void write(ostream& os) const {
+		const uint64_t n = parts.size();
+		os.write((const char*)&n, sizeof(n));
+		os.write((const char*)parts.data(), n * sizeof(uint64_t));
+	}
+
+	static LNum read(istream& is) {
+		uint64_t n = 0;
+		is.read((char*)&n, sizeof(n));
+		LNum res;
+		res.parts.resize(n);
+		is.read((char*)res.parts.data(), n * sizeof(uint64_t));
+		return res;
 	}
 	LNum() {}
 private:
-	static void remove_zeros(vector<uint64_t>& v) {
+	static void remove_zeros(Limbs& v) {
 		while (v.size() > 1 && v.back() == 0)
 			v.pop_back();
 	}
 
-	vector<vector<uint64_t>> decompose(LNum l) {
+	static constexpr unsigned LOW_BITS = 9;
+	// Numbers above this many limbs go to and from binary by halves
+	static constexpr size_t WORDS_SPLIT_LIMBS = 256;
+
+	// *this >>= shift for shift <= 32, returns the bits shifted out
+	uint64_t shr_small(unsigned shift) {
+		const uint64_t mask = (uint64_t(1) << shift) - 1;
+		uint64_t carry = 0;
+		for (int64_t i = parts.size() - 1; i >= 0; --i) {
+			const uint64_t cur = carry * base + parts[i];
+			parts[i] = cur >> shift;
+			carry = cur & mask;
+		}
+		remove_zeros(parts);
+		return carry;
+	}
+
+	// 2^k by squaring, O(M(n))
+	static LNum pow2(uint64_t k) {
+		LNum res(uint64_t(1) << k % 32), cur(uint64_t(1) << 32);
+		for (k /= 32; k > 0; k >>= 1) {
+			if (k & 1)
+				res *= cur;
+			if (k > 1)
+				cur *= cur;
+		}
+		return res;
+	}
+
+	// The low count limbs mod 2^bits as little-endian 2⁶⁴ words, which for count >= bits / 9 are the low bits
+	// of the whole number. Horner's rule kept to the words bits needs, O(count·bits / 64)
+	vector<uint64_t> low_words(size_t count, uint64_t bits) const {
+		vector<uint64_t> words((bits + 63) / 64);
+		size_t used = 0;
+		for (int64_t i = int64_t(min(count, parts.size())) - 1; i >= 0; --i) {
+			uint64_t carry = parts[i];
+			for (size_t j = 0; j < used; ++j)
+				words[j] = mul_add_wide(0, words[j], base, carry);
+			if (carry != 0 && used < words.size())
+				words[used++] = carry;
+		}
+		if (bits % 64 != 0)
+			words.back() &= (uint64_t(1) << bits % 64) - 1;
+		return words;
+	}
+
+	// Little-endian 2⁶⁴ words. Long numbers split at 2^(64h) for half their words, O(M(n)·log n)
+	vector<uint64_t> to_words() const {
+		if (parts.size() > WORDS_SPLIT_LIMBS) {
+			const size_t h = (bit_length() + 127) / 128;
+			LNum hi, lo;
+			divmod_limbs(parts, pow2(64 * h).parts, &hi.parts, lo.parts);
+			vector<uint64_t> words = lo.to_words();
+			words.resize(h);
+			const vector<uint64_t> high = hi.to_words();
+			words.insert(words.end(), high.begin(), high.end());
+			return words;
+		}
+
+		vector<uint64_t> words;
+		LNum v = *this;
+		while (!v.is_zero()) {
+			const uint64_t lo = v.shr_small(32);
+			const uint64_t hi = v.shr_small(32);
+			words.push_back(hi << 32 | lo);
+		}
+		return words;
+	}
+
+	static LNum from_words(const vector<uint64_t>& words) {
+		return from_words(words.data(), words.size());
+	}
+
+	static LNum from_words(const uint64_t* words, size_t count) {
+		if (count > WORDS_SPLIT_LIMBS / 2) {
+			const size_t h = count / 2;
+			LNum res = from_words(words + h, count - h);
+			res <<= 64 * h;
+			res += from_words(words, h);
+			return res;
+		}
+
+		LNum res = 0;
+		for (int64_t i = count - 1; i >= 0; --i) {
+			res <<= 32;
+			res += words[i] >> 32;
+			res <<= 32;
+			res += words[i] & UINT32_MAX;
+		}
+		return res;
+	}
+
+	template <typename Op>
+	static LNum bitwise(const LNum& lhs, const LNum& rhs, Op op) {
+		vector<uint64_t> a = lhs.to_words(), b = rhs.to_words();
+		a.resize(max(a.size(), b.size()));
+		b.resize(a.size());
+		transform(a.begin(), a.end(), b.begin(), a.begin(), op);
+		return from_words(a);
+	}
+
+	enum Scratch { SCRATCH_CUR, SCRATCH_REM, SCRATCH_PROD, SCRATCH_COUNT };
+
+	// Per-thread buffers that in-place operators swap with, so their capacity survives between calls
+	static Limbs& scratch(Scratch slot) {
+		static thread_local Limbs buffers[SCRATCH_COUNT];
+		return buffers[slot];
+	}
+
+	static int compare_limbs(const Limbs& lhs, const Limbs& rhs) {
+		if (lhs.size() != rhs.size())
+			return lhs.size() < rhs.size() ? -1 : 1;
+		for (int64_t i = lhs.size() - 1; i >= 0; --i)
+			if (lhs[i] != rhs[i])
+				return lhs[i] < rhs[i] ? -1 : 1;
+		return 0;
+	}
+
+	// Operands from this many limbs on go through LimbKernels in carry-save form
+	static constexpr size_t CARRY_SAVE_LIMBS = 8;
+	// Rows of a product summed before normalizing, 16 * (10⁹)² plus carries still fits in 64 bits
+	static constexpr size_t CARRY_SAVE_ROWS = 16;
+
+	// Propagates carries through v[from, to) and on while any remain; limbs may hold up to ~1.6 * 10¹⁹
+	static void normalize_limbs(Limbs& v, size_t from, size_t to) {
+		uint64_t carry = 0;
+		for (size_t i = from; i < to || carry; ++i) {
+			if (i == v.size())
+				v.push_back(0);
+			uint64_t cur = v[i] + carry;
+			v[i] = cur % base;
+			carry = cur / base;
+		}
+	}
+
+	// lhs += rhs, rhs may alias lhs
+	static void add_limbs(Limbs& lhs, const Limbs& rhs) {
+		if (rhs.size() >= CARRY_SAVE_LIMBS) {
+			if (lhs.size() < rhs.size())
+				lhs.resize(rhs.size(), 0);
+			LimbKernels::get().add(lhs.data(), rhs.data(), rhs.size());
+			uint64_t carry = 0;
+			for (size_t i = 0; i < rhs.size() || (carry && i < lhs.size()); ++i) {
+				uint64_t cur = lhs[i] + carry;
+				carry = cur >= base;
+				lhs[i] = cur - (carry ? base : 0);
+			}
+			if (carry)
+				lhs.push_back(1);
+			return;
+		}
+		uint64_t carry = 0;
+		for (size_t i = 0; i < max(lhs.size(), rhs.size()) || carry; ++i) {
+			if (i == lhs.size())
+				lhs.push_back(0);
+			lhs[i] += carry + (i < rhs.size() ? rhs[i] : 0);
+			carry = lhs[i] >= base;
+			if (carry) lhs[i] -= base;
+		}
+	}
+
+	// lhs -= rhs, requires lhs >= rhs
+	static void sub_limbs(Limbs& lhs, const Limbs& rhs) {
+		if (rhs.size() >= CARRY_SAVE_LIMBS) {
+			LimbKernels::get().sub(lhs.data(), rhs.data(), rhs.size());
+			uint64_t borrow = 0;
+			for (size_t i = 0; i < rhs.size() || borrow; ++i) {
+				uint64_t cur = lhs[i] + (i < rhs.size() ? 0 : base) - borrow;
+				borrow = cur < base;
+				lhs[i] = cur - (borrow ? 0 : base);
+			}
+			remove_zeros(lhs);
+			return;
+		}
+		uint64_t carry = 0;
+		for (size_t i = 0; i < rhs.size() || carry; ++i) {
+			uint64_t temp = carry + (i < rhs.size() ? rhs[i] : 0);
+			carry = lhs[i] < temp;
+			if (carry) {
+#if _DEBUG
+				assert(base > temp);
+#endif
+				lhs[i] += base - temp;
+			}
+			else {
+				lhs[i] -= temp;
+			}
+		}
+		remove_zeros(lhs);
+	}
+
+	// out = lhs * rhs, out must not alias the operands
+	static void mul_word_limbs(Limbs& out, const Limbs& lhs, uint64_t rhs) {
+		if (lhs.size() >= CARRY_SAVE_LIMBS && rhs <= UINT32_MAX) {
+			out.resize(lhs.size());
+			LimbKernels::get().mul(out.data(), lhs.data(), lhs.size(), rhs);
+			normalize_limbs(out, 0, out.size());
+			remove_zeros(out);
+			return;
+		}
+		out.clear();
+		uint64_t carry = 0;
+		for (size_t i = 0; i < lhs.size() || carry; ++i) {
+			uint64_t cur = carry + (i < lhs.size() ? lhs[i] : 0) * 1ll * rhs;
+			out.push_back(uint64_t(cur % base));
+			carry = uint64_t(cur / base);
+		}
+		remove_zeros(out);
+	}
+
+	// acc += lhs * rhs, acc must not alias the operands.
+	// Long operands add whole rows without carries and normalize every CARRY_SAVE_ROWS rows.
+	static void mul_acc_limbs(Limbs& acc, const Limbs& lhs, const Limbs& rhs) {
+		acc.resize(max(acc.size(), lhs.size() + rhs.size()) + 1, 0);
+		if (min(lhs.size(), rhs.size()) >= CARRY_SAVE_LIMBS) {
+			const Limbs& row = lhs.size() >= rhs.size() ? lhs : rhs;
+			const Limbs& col = lhs.size() >= rhs.size() ? rhs : lhs;
+			const LimbKernels& kernels = LimbKernels::get();
+			for (size_t i = 0, from = 0; i < col.size(); ++i) {
+				kernels.mul_row(acc.data() + i, row.data(), row.size(), col[i]);
+				if (i + 1 - from == CARRY_SAVE_ROWS || i + 1 == col.size()) {
+					normalize_limbs(acc, from, i + row.size());
+					from = i + 1;
+				}
+			}
+			remove_zeros(acc);
+			return;
+		}
+		for (size_t i = 0; i < lhs.size(); ++i)
+			for (size_t j = 0, carry = 0; j < rhs.size() || carry; ++j) {
+				uint64_t cur = acc[i + j] + lhs[i] * 1ll * (j < rhs.size() ? rhs[j] : 0) + carry;
+				acc[i + j] = uint64_t(cur % base);
+				carry = uint64_t(cur / base);
+			}
+		remove_zeros(acc);
+	}
+
+	// Products with both operands from this many limbs on are split by Karatsuba, below it the carry-save rows win
+	static constexpr size_t KARATSUBA_LIMBS = 384;
+	// Divisors from this many limbs on divide through a Newton reciprocal when the quotient is at least half as
+	// long; its cost is mostly the reciprocal, so a shorter quotient is cheaper by long division
+	static constexpr size_t NEWTON_LIMBS = 128;
+
+	// Limbs [from, to) of v as a number of their own
+	static Limbs slice_limbs(const Limbs& v, size_t from, size_t to) {
+		to = min(to, v.size());
+		Limbs res = from < to ? Limbs(v.begin() + from, v.begin() + to) : Limbs{ 0 };
+		remove_zeros(res);
+		return res;
+	}
+
+	// v *= base^k
+	static void shl_limbs(Limbs& v, size_t k) {
+		if (v.size() == 1 && v[0] == 0)
+			return;
+		v.resize(v.size() + k, 0);
+		copy_backward(v.begin(), v.end() - k, v.end());
+		fill(v.begin(), v.begin() + k, 0);
+	}
+
+	// acc += v * base^shift
+	static void add_shifted_limbs(Limbs& acc, const Limbs& v, size_t shift) {
+		if (acc.size() < shift + v.size())
+			acc.resize(shift + v.size(), 0);
+		uint64_t carry = 0;
+		for (size_t i = 0; i < v.size() || carry; ++i) {
+			if (shift + i == acc.size())
+				acc.push_back(0);
+			const uint64_t cur = acc[shift + i] + carry + (i < v.size() ? v[i] : 0);
+			carry = cur >= base;
+			acc[shift + i] = cur - (carry ? base : 0);
+		}
+	}
+
+	// out = lhs * rhs, out must not alias the operands
+	static void mul_limbs(Limbs& out, const Limbs& lhs, const Limbs& rhs) {
+		if (min(lhs.size(), rhs.size()) >= KARATSUBA_LIMBS) {
+			karatsuba_limbs(out, lhs, rhs);
+			return;
+		}
+		out.clear();
+		mul_acc_limbs(out, lhs, rhs);
+	}
+
+	// With x = x₁·base^h + x₀: lhs·rhs = z₂·base^2h + z₁·base^h + z₀, z₁ = (l₀ + l₁)(r₀ + r₁) - z₀ - z₂,
+	// three half-size products instead of four, O(n^1.58)
+	static void karatsuba_limbs(Limbs& out, const Limbs& lhs, const Limbs& rhs) {
+		const Limbs& big = lhs.size() >= rhs.size() ? lhs : rhs;
+		const Limbs& small = lhs.size() >= rhs.size() ? rhs : lhs;
+		// Lopsided operands: the longer one is cut into pieces as long as the shorter
+		if (2 * small.size() <= big.size()) {
+			Limbs prod, acc{ 0 };
+			for (size_t from = 0; from < big.size(); from += small.size()) {
+				mul_limbs(prod, slice_limbs(big, from, from + small.size()), small);
+				add_shifted_limbs(acc, prod, from);
+			}
+			remove_zeros(acc);
+			out.swap(acc);
+			return;
+		}
+
+		const size_t h = big.size() / 2;
+		Limbs l0 = slice_limbs(lhs, 0, h), l1 = slice_limbs(lhs, h, lhs.size());
+		Limbs r0 = slice_limbs(rhs, 0, h), r1 = slice_limbs(rhs, h, rhs.size());
+		Limbs z0, z1, z2;
+		mul_limbs(z0, l0, r0);
+		mul_limbs(z2, l1, r1);
+		add_limbs(l0, l1);
+		add_limbs(r0, r1);
+		mul_limbs(z1, l0, r0);
+		sub_limbs(z1, z0);
+		sub_limbs(z1, z2);
+		add_shifted_limbs(z0, z1, h);
+		add_shifted_limbs(z0, z2, 2 * h);
+		remove_zeros(z0);
+		out.swap(z0);
+	}
+
+	// floor(base^2m / d) for d of m limbs. The reciprocal of the top h limbs of d, 2h >= m + 4, shifted into
+	// place is within base^(1-h) of it relatively; one Newton step x += x·(base^2m - d·x) / base^2m squares
+	// that error to under a unit, and one more product settles x exactly. O(M(m)) over all levels.
+	static Limbs reciprocal_limbs(const Limbs& d) {
+		const size_t m = d.size();
+		Limbs one(2 * m + 1, 0), x, t, e, c;
+		one.back() = 1;
+		if (m < NEWTON_LIMBS) {
+			long_divmod_limbs(one, d, &x, t);
+			return x;
+		}
+
+		const size_t h = (m + 5) / 2;
+		x = reciprocal_limbs(slice_limbs(d, m - h, m));
+		shl_limbs(x, m - h);
+		mul_limbs(t, d, x);
+		if (compare_limbs(t, one) <= 0) {
+			e = one;
+			sub_limbs(e, t);
+			mul_limbs(c, x, e);
+			add_limbs(x, slice_limbs(c, 2 * m, c.size()));
+		}
+		else {
+			e = t;
+			sub_limbs(e, one);
+			mul_limbs(c, x, e);
+			Limbs step = slice_limbs(c, 2 * m, c.size());
+			add_limbs(step, Limbs{ 1 });
+			sub_limbs(x, step);
+		}
+
+		mul_limbs(t, d, x);
+		while (compare_limbs(t, one) > 0) {
+			sub_limbs(x, Limbs{ 1 });
+			sub_limbs(t, d);
+		}
+		add_limbs(t, d);
+		while (compare_limbs(t, one) <= 0) {
+			add_limbs(x, Limbs{ 1 });
+			add_limbs(t, d);
+		}
+		return x;
+	}
+
+	// quot may be null
+	static void divmod_limbs(const Limbs& lhs, const Limbs& rhs, Limbs* quot, Limbs& rem) {
+		if (rhs.size() >= NEWTON_LIMBS && lhs.size() >= rhs.size() + rhs.size() / 2)
+			newton_divmod_limbs(lhs, rhs, quot, rem);
+		else
+			long_divmod_limbs(lhs, rhs, quot, rem);
+	}
+
+	// Division through r = floor(base^2m / rhs). lhs is taken m limbs at a time from the top, and every
+	// u = rem·base^m + chunk < rhs·base^m gets q = floor(u·r / base^2m), at most two below u / rhs.
+	// O(M(m)) per m limbs of lhs.
+	static void newton_divmod_limbs(const Limbs& lhs, const Limbs& rhs, Limbs* quot, Limbs& rem) {
+		const size_t m = rhs.size();
+		const Limbs r = reciprocal_limbs(rhs);
+		if (quot) {
+			quot->clear();
+			quot->resize(lhs.size(), 0);
+		}
+		rem.clear();
+		rem.push_back(0);
+		Limbs u, p, q;
+		for (size_t chunk = (lhs.size() + m - 1) / m; chunk-- > 0;) {
+			const size_t from = chunk * m;
+			u.swap(rem);
+			shl_limbs(u, m);
+			add_limbs(u, slice_limbs(lhs, from, from + m));
+			mul_limbs(p, u, r);
+			q = slice_limbs(p, 2 * m, p.size());
+			mul_limbs(p, q, rhs);
+			rem.swap(u);
+			sub_limbs(rem, p);
+			while (compare_limbs(rem, rhs) >= 0) {
+				sub_limbs(rem, rhs);
+				add_limbs(q, Limbs{ 1 });
+			}
+			if (quot)
+				copy(q.begin(), q.end(), quot->begin() + from);
+		}
+		if (quot)
+			remove_zeros(*quot);
+	}
+
+	// Long division, one base 10⁹ digit at a time; quot may be null. A digit is estimated from the top limbs
+	// of rem and rhs, which is at most a couple of steps off, so each costs O(m): O(m·(n - m + 1)) in all.
+	static void long_divmod_limbs(const Limbs& lhs, const Limbs& rhs, Limbs* quot, Limbs& rem) {
+		Limbs& cur = scratch(SCRATCH_CUR);
+		const size_t s = rhs.size();
+		const ldouble d = ldouble(rhs[s - 1]) * base + (s > 1 ? rhs[s - 2] : 0);
+		if (quot) {
+			quot->clear();
+			quot->resize(lhs.size(), 0);
+		}
+		// The top s - 1 limbs of lhs are below rhs, the digits start under them
+		const size_t start = lhs.size() >= s ? lhs.size() - s + 1 : 0;
+		rem = slice_limbs(lhs, start, lhs.size());
+		for (size_t i = start; i-- > 0;) {
+			// rem = rem * base + lhs[i]
+			if (rem.size() > 1 || rem[0] != 0) {
+				rem.push_back(0);
+				copy_backward(rem.begin(), prev(rem.end()), rem.end());
+			}
+			rem[0] = lhs[i];
+			if (compare_limbs(rem, rhs) < 0)
+				continue;
+
+			// rem < rhs * base, so it has s or s + 1 limbs
+			const ldouble r = ldouble(rem.size() > s ? rem[s] : 0) * base * base + ldouble(rem[s - 1]) * base + (s > 1 ? rem[s - 2] : 0);
+			uint64_t x = d > 0 ? min<uint64_t>(uint64_t(r / d), base - 1) : base - 1;
+			mul_word_limbs(cur, rhs, x);
+			while (compare_limbs(cur, rem) > 0) {
+				--x;
+				sub_limbs(cur, rhs);
+			}
+			sub_limbs(rem, cur);
+			while (x + 1 < base && compare_limbs(rem, rhs) >= 0) {
+				++x;
+				sub_limbs(rem, rhs);
+			}
+			if (quot)
+				(*quot)[i] = x;
+		}
+		if (quot)
+			remove_zeros(*quot);
+	}
+
+	static valarray<Complex> ComputeZeta(uint64_t N, uint64_t P) {
+		valarray<Complex> zeta(P);
+		for (uint64_t k = 0; k < P; ++k) {
+			zeta[k] = exp(1il * PI * ldouble(2 * k + 1) / ldouble(N));
+		}
+		return zeta;
+	}
+
+	static vector<vector<uint64_t>> decompose(const FftPlan& plan, LNum l) {
+		const uint64_t N = plan.N, P = plan.P;
 		vector<vector<uint64_t>> a(N);
 		for (uint64_t i = 0; i < N; ++i) {
 			a[i].resize(P);
 			for (uint64_t j = 0; j < P / 2; ++j) {
-				a[i][j] = l % std::pow(2, P);
-				l /= std::pow(2, P);
+				a[i][j] = l % (uint64_t(1) << P);
+				l >>= P;
 			}
 			for (uint64_t j = P / 2; j < P; ++j) {
 				a[i][j] = 0;
@@ -525,7 +2059,8 @@ private:
 		return a;
 	}
 
-	LNum compose(vector<valarray<Complex>> a0) {
+	static LNum compose(const FftPlan& plan, const vector<valarray<Complex>>& a0) {
+		const uint64_t N = plan.N, P = plan.P;
 		LNum v = 0;
 		//for (int64_t i = 0; i < N; ++i) {
 		//	for (int64_t j = 0; j < P; ++j) {
@@ -552,101 +2087,428 @@ private:
 		return v;//v.mod(LNum(2).pow(n));
 	}
 
-	vector<valarray<Complex>> fft(vector<valarray<Complex>> a, valarray<Complex> w_, uint64_t N_) {
-		if (N_ == 1) {
-			return a;
-		}
-		else if (N_ == 2) {
-			vector<valarray<Complex>> b(N_);
-			b[0] = a[0] + a[1];
-			b[1] = a[0] - a[1];
-			return b;
-		}
+	// Transforms a in place. Rows are moved through the node's scratch instead of copied, and the
+	// twiddles come from its table, so the recursion itself allocates nothing
+	static void fft(FftNode& node, vector<valarray<Complex>>& a) {
+		if (node.n == 1) {
+			return;
+		}
+		else if (node.n == 2) {
+			for (size_t i = 0; i < a[0].size(); ++i) {
+				const Complex x = a[0][i];
+				a[0][i] += a[1][i];
+				a[1][i] = x - a[1][i];
+			}
+			return;
+		}
+
+		const uint64_t J = node.J, K = node.K;
+		assert(K > 0);
+		for (uint64_t k = 0; k < K; ++k) {
+			for (uint64_t k1 = 0; k1 < J; ++k1) {
+				node.c[k][k1] = move(a[k1 * K + k]);
+			}
+
+			fft(*node.inner, node.c[k]);
+		}
+
+		vector<valarray<Complex>>& d_j = node.d;
+		for (uint64_t j = 0; j < J; ++j) {
+			for (uint64_t k = 0; k < K; ++k) {
+				d_j[k] = move(node.c[k][j]);
+				d_j[k] *= node.twiddles[j * K + k];
+			}
+
+			fft(*node.outer, d_j);
+
+			for (uint64_t j1 = 0; j1 < K; ++j1) {
+				a[j1 * J + j] = move(d_j[j1]);
+			}
+		}
+	}
+
+	static vector<valarray<Complex>> half_fft(FftPlan& plan, const vector<vector<uint64_t>>& a_real) {
+		const uint64_t N = plan.N, P = plan.P;
+		vector<valarray<Complex>> a(N);
+		for (size_t i = 0; i < N; ++i) {
+			a[i].resize(P);
+			for (size_t j = 0; j < P; ++j) {
+				a[i][j] = Complex(a_real[i][j], 0);
+			}
+		}
+		for (uint64_t k = 0; k < N; ++k) {
+			a[k] *= plan.zeta_pow[k];
+		}
+		fft(*plan.forward, a);
+		return a;
+	}
+
+	static vector<valarray<Complex>> inv_half_fft(FftPlan& plan, vector<valarray<Complex>> b) {
+		const uint64_t N = plan.N;
+
+		fft(*plan.inverse, b);
+
+		for (uint64_t k = 0; k < N; ++k) {
+			b[k] = b[k] * plan.inv_zeta_pow[k] / N;
+		}
+
+		return b;
+	}
+
+	// n uniform limbs; every word gives two 30-bit candidates, kept when below base (93% of them)
+	static void random_limbs(uint64_t* out, size_t n, RandomSource& source) {
+		constexpr uint64_t mask = (uint64_t(1) << 30) - 1;
+		source.fill(out, n);
+		for (size_t i = 0; i < n; ++i) {
+			for (uint64_t word = out[i];; word = source.next()) {
+				if ((word & mask) < base) {
+					out[i] = word & mask;
+					break;
+				}
+				if ((word >> 32 & mask) < base) {
+					out[i] = word >> 32 & mask;
+					break;
+				}
+			}
+		}
+	}
+
+	friend class LNumHasher;
+	template <size_t Bits> friend class FixedNum;
+};
+
+class LNumHasher {
+public:
+	size_t operator()(LNum const& n) const {
+		const auto& vec = n.parts;
+		size_t seed = vec.size();
+		const auto m = uint64_t((sqrtl(5) - 1.l) * powl(2, CHAR_BIT * sizeof(uint64_t) - 1));
+		for (auto& i : vec) {
+			seed ^= i + m + (seed << 6) + (seed >> 2);
+		}
+		return seed;
+	}
+};
+
+ostream& operator<<(ostream& os, const LNum& ln) {
+	return os << ln.to_str();
+}
+
+// Fixed-width unsigned integer with 2⁶⁴ limbs for moduli of known size (ElGamal groups of 256, 2048, 3072 bits).
+// All loops run over WORDS, so the compiler can unroll them and keep the value on the stack.
+template <size_t Bits>
+class FixedNum {
+	static_assert(Bits > 0 && Bits % 64 == 0, "FixedNum width must be a multiple of 64 bits");
+
+public:
+	static constexpr size_t WORDS = Bits / 64;
+
+	array<uint64_t, WORDS> w{};
+
+	constexpr FixedNum() {}
+
+	constexpr FixedNum(uint64_t v) {
+		w[0] = v;
+	}
+
+	explicit FixedNum(const LNum& v) {
+		for (int64_t i = v.parts.size() - 1; i >= 0; --i) {
+			if (mul_word_add(LNum::base, v.parts[i]) != 0)
+				throw out_of_range("LNum does not fit into FixedNum");
+		}
+	}
+
+	LNum to_lnum() const {
+		LNum res = 0;
+		for (int64_t i = WORDS - 1; i >= 0; --i) {
+			res *= uint64_t(1) << 32;
+			res += w[i] >> 32;
+			res *= uint64_t(1) << 32;
+			res += w[i] & UINT32_MAX;
+		}
+		return res;
+	}
+
+	constexpr bool is_zero() const {
+		for (size_t i = 0; i < WORDS; ++i)
+			if (w[i] != 0)
+				return false;
+		return true;
+	}
+
+	constexpr bool is_odd() const {
+		return w[0] & 1;
+	}
+
+	constexpr bool bit(size_t i) const {
+		return (w[i / 64] >> (i % 64)) & 1;
+	}
+
+	constexpr size_t bit_length() const {
+		for (int64_t i = WORDS - 1; i >= 0; --i)
+			for (int64_t j = 63; j >= 0; --j)
+				if ((w[i] >> j) & 1)
+					return i * 64 + j + 1;
+		return 0;
+	}
+
+	constexpr int compare(const FixedNum& rhs) const {
+		for (int64_t i = WORDS - 1; i >= 0; --i)
+			if (w[i] != rhs.w[i])
+				return w[i] < rhs.w[i] ? -1 : 1;
+		return 0;
+	}
+
+	constexpr bool operator ==(const FixedNum& rhs) const { return compare(rhs) == 0; }
+	constexpr bool operator !=(const FixedNum& rhs) const { return compare(rhs) != 0; }
+	constexpr bool operator <(const FixedNum& rhs) const { return compare(rhs) < 0; }
+	constexpr bool operator >(const FixedNum& rhs) const { return compare(rhs) > 0; }
+	constexpr bool operator <=(const FixedNum& rhs) const { return compare(rhs) <= 0; }
+	constexpr bool operator >=(const FixedNum& rhs) const { return compare(rhs) >= 0; }
+
+	// Returns the carry out of the top word
+	constexpr uint64_t add(const FixedNum& rhs) {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < WORDS; ++i) {
+			const uint64_t sum = w[i] + rhs.w[i];
+			const uint64_t out = sum < w[i];
+			w[i] = sum + carry;
+			carry = out | (w[i] < sum);
+		}
+		return carry;
+	}
+
+	// Returns the borrow out of the top word
+	constexpr uint64_t sub(const FixedNum& rhs) {
+		uint64_t borrow = 0;
+		for (size_t i = 0; i < WORDS; ++i) {
+			const uint64_t diff = w[i] - rhs.w[i];
+			const uint64_t out = w[i] < rhs.w[i];
+			w[i] = diff - borrow;
+			borrow = out | (diff < borrow);
+		}
+		return borrow;
+	}
+
+	// *this = *this * m + a, returns the word that did not fit
+	constexpr uint64_t mul_word_add(uint64_t m, uint64_t a) {
+		uint64_t carry = a;
+		for (size_t i = 0; i < WORDS; ++i)
+			w[i] = mul_add_wide(0, w[i], m, carry);
+		return carry;
+	}
+
+	// Returns the bit shifted out of the top word
+	constexpr uint64_t shl1() {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < WORDS; ++i) {
+			const uint64_t out = w[i] >> 63;
+			w[i] = (w[i] << 1) | carry;
+			carry = out;
+		}
+		return carry;
+	}
+
+	constexpr void shr1() {
+		for (size_t i = 0; i < WORDS; ++i)
+			w[i] = (w[i] >> 1) | (i + 1 < WORDS ? w[i + 1] << 63 : 0);
+	}
+
+	constexpr FixedNum& operator +=(const FixedNum& rhs) { add(rhs); return *this; }
+	constexpr FixedNum& operator -=(const FixedNum& rhs) { sub(rhs); return *this; }
+	constexpr FixedNum operator +(const FixedNum& rhs) const { FixedNum res = *this; return res += rhs; }
+	constexpr FixedNum operator -(const FixedNum& rhs) const { FixedNum res = *this; return res -= rhs; }
+
+	// Full double-width product
+	constexpr FixedNum<2 * Bits> mul_wide(const FixedNum& rhs) const {
+		FixedNum<2 * Bits> res;
+		for (size_t i = 0; i < WORDS; ++i) {
+			uint64_t carry = 0;
+			for (size_t j = 0; j < WORDS; ++j)
+				res.w[i + j] = mul_add_wide(res.w[i + j], w[i], rhs.w[j], carry);
+			res.w[i + WORDS] = carry;
+		}
+		return res;
+	}
+
+	// Product truncated to Bits
+	constexpr FixedNum operator *(const FixedNum& rhs) const {
+		FixedNum res;
+		for (size_t i = 0; i < WORDS; ++i) {
+			uint64_t carry = 0;
+			for (size_t j = 0; i + j < WORDS; ++j)
+				res.w[i + j] = mul_add_wide(res.w[i + j], w[i], rhs.w[j], carry);
+		}
+		return res;
+	}
+
+	// x mod m by binary long division, m must be non-zero
+	template <size_t XBits>
+	static constexpr FixedNum mod(const FixedNum<XBits>& x, const FixedNum& m) {
+		FixedNum r;
+		for (int64_t i = x.bit_length() - 1; i >= 0; --i) {
+			const uint64_t out = r.shl1();
+			r.w[0] |= x.bit(i);
+			if (out || r >= m)
+				r.sub(m);
+		}
+		return r;
+	}
+
+	constexpr FixedNum operator %(const FixedNum& m) const {
+		return mod(*this, m);
+	}
 
-		assert(N_ >= 4);
-		const uint64_t J = (N_ <= 2 * P) ? 2 : 2 * P;
-		const uint64_t K = N_ / J;
+	constexpr FixedNum mul_mod(const FixedNum& rhs, const FixedNum& m) const {
+		return mod(mul_wide(rhs), m);
+	}
 
-		vector<vector<valarray<Complex>>> c(K);
-		assert(K > 0);
-		for (uint64_t k = 0; k < K; ++k) {
-			c[k].resize(J);
-			for (uint64_t k1 = 0; k1 < J; ++k1) {
-				c[k][k1] = a[k1 * K + k];
-			}
+	constexpr FixedNum pow_mod(const FixedNum& exp, const FixedNum& modulus) const;
 
-			c[k] = fft(c[k], ::pow(w_, 2), J);
-		}
+	bool is_prime(int certainty) const;
+};
 
-		vector<valarray<Complex>> b(N_);
-		for (uint64_t j = 0; j < J; ++j) {
-			vector<valarray<Complex>> d_j(K);
-			for (uint64_t k = 0; k < K; ++k) {
-				d_j[k] = c[k][j] * ::pow(w_, j * k);
-			}
+// Montgomery arithmetic modulo an odd FixedNum, values are kept as a * R mod m with R = 2^Bits
+template <size_t Bits>
+class Montgomery {
+	typedef FixedNum<Bits> Num;
+	static constexpr size_t WORDS = Num::WORDS;
 
-			d_j = fft(d_j, ::pow(w_, J), K);
+	Num m;
+	uint64_t m_inv = 0; // -m⁻¹ mod 2⁶⁴
+	Num r1;             // R mod m
+	Num r2;             // R² mod m
 
-			for (uint64_t j1 = 0; j1 < K; ++j1) {
-				b[j1 * J + j] = d_j[j1];
-			}
+public:
+	constexpr Montgomery(const Num& modulus) : m(modulus) {
+		assert(m.is_odd());
+		uint64_t inv = 1;
+		for (int i = 0; i < 6; ++i)
+			inv *= 2 - m.w[0] * inv;
+		m_inv = 0 - inv;
+
+		r1 = Num(1) % m;
+		for (size_t i = 0; i < Bits; ++i)
+			if (r1.shl1() || r1 >= m)
+				r1.sub(m);
+		r2 = r1;
+		for (size_t i = 0; i < Bits; ++i)
+			if (r2.shl1() || r2 >= m)
+				r2.sub(m);
+	}
+
+	const Num& modulus() const {
+		return m;
+	}
+
+	// a * b / R mod m, both inputs below m
+	constexpr Num mul(const Num& a, const Num& b) const {
+		uint64_t t[WORDS + 2] = {};
+		for (size_t i = 0; i < WORDS; ++i) {
+			uint64_t carry = 0;
+			for (size_t j = 0; j < WORDS; ++j)
+				t[j] = mul_add_wide(t[j], a.w[j], b.w[i], carry);
+			t[WORDS] += carry;
+			t[WORDS + 1] = t[WORDS] < carry;
+
+			const uint64_t q = t[0] * m_inv;
+			carry = 0;
+			mul_add_wide(t[0], q, m.w[0], carry);
+			for (size_t j = 1; j < WORDS; ++j)
+				t[j - 1] = mul_add_wide(t[j], q, m.w[j], carry);
+			t[WORDS - 1] = t[WORDS] + carry;
+			t[WORDS] = t[WORDS + 1] + (t[WORDS - 1] < carry);
 		}
-
-		return b;
+		Num res;
+		for (size_t i = 0; i < WORDS; ++i)
+			res.w[i] = t[i];
+		if (t[WORDS] || res >= m)
+			res.sub(m);
+		return res;
 	}
 
-	vector<valarray<Complex>> half_fft(vector<vector<uint64_t>> a_real, valarray<Complex> dzeta) {
-		vector<valarray<Complex>> a(N);
-		for (size_t i = 0; i < N; ++i) {
-			a[i].resize(P);
-			for (size_t j = 0; j < P; ++j) {
-				a[i][j] = Complex(a_real[i][j], 0);
-			}
-		}
-		for (uint64_t k = 0; k < N; ++k) {
-			a[k] *= ::pow(dzeta, k);
-		}
-		return fft(a, ::pow(dzeta, 2), N);
+	constexpr Num to_mont(const Num& a) const {
+		return mul(a, r2);
 	}
 
-	vector<valarray<Complex>> inv_half_fft(vector<valarray<Complex>> c, valarray<Complex> dzeta) {
-		valarray<Complex> w = ::pow(dzeta, 2);
+	constexpr Num from_mont(const Num& a) const {
+		return mul(a, 1);
+	}
 
-		vector<valarray<Complex>> b = fft(c, ::pow(w, -1), N);
+	constexpr Num one() const {
+		return r1;
+	}
 
-		for (int64_t k = 0; k < N; ++k) {
-			b[k] = b[k] * ::pow(dzeta, ldouble(-k)) / N;
+	constexpr Num pow(const Num& base, const Num& exp) const {
+		const Num x = to_mont(base % m);
+		Num res = r1;
+		for (int64_t i = exp.bit_length() - 1; i >= 0; --i) {
+			res = mul(res, res);
+			if (exp.bit(i))
+				res = mul(res, x);
 		}
+		return from_mont(res);
+	}
+};
 
-		return b;
+template <size_t Bits>
+constexpr FixedNum<Bits> FixedNum<Bits>::pow_mod(const FixedNum& exp, const FixedNum& modulus) const {
+	if (modulus.is_odd())
+		return Montgomery<Bits>(modulus).pow(*this, exp);
+
+	FixedNum base = *this % modulus;
+	FixedNum result = FixedNum(1) % modulus;
+	for (int64_t i = exp.bit_length() - 1; i >= 0; --i) {
+		result = result.mul_mod(result, modulus);
+		if (exp.bit(i))
+			result = result.mul_mod(base, modulus);
 	}
+	return result;
+}
 
-	static uint64_t base_max() {
-		uint64_t res = 0;
-		for (uint64_t i = 0; i < BASE_POWER; ++i) {
-			res += 9 * pow(10, i);
-		}
-		return res;
+// Miller–Rabin primality test over Montgomery arithmetic
+template <size_t Bits>
+bool FixedNum<Bits>::is_prime(int certainty) const {
+	if (*this == 1) return true;
+	if (*this == 2 || *this == 3)
+		return true;
+	if (*this < 2 || !is_odd())
+		return false;
+
+	const Montgomery<Bits> mont(*this);
+	const FixedNum n_1 = *this - 1;
+	const FixedNum one = mont.one();
+	const FixedNum minus_one = mont.to_mont(n_1);
+	FixedNum d = n_1;
+	int s = 0;
+
+	while (!d.is_odd()) {
+		d.shr1();
+		s += 1;
 	}
 
-	friend class LNumHasher;
-};
+	const LNum n = to_lnum();
+	for (int i = 0; i < certainty; ++i) {
+		STATS_COUNT(MILLER_RABIN_ROUNDS, 1);
+		const FixedNum a(LNum::random(2, n - 3));
 
-class LNumHasher {
-public:
-	size_t operator()(LNum const& n) const {
-		auto vec = n.parts;
-		size_t seed = vec.size();
-		const auto m = uint64_t((sqrtl(5) - 1.l) * powl(2, CHAR_BIT * sizeof(uint64_t) - 1));
-		for (auto& i : vec) {
-			seed ^= i + m + (seed << 6) + (seed >> 2);
+		FixedNum x = mont.to_mont(mont.pow(a, d));
+		if (x == one || x == minus_one)
+			continue;
+
+		for (int r = 1; r < s; ++r) {
+			x = mont.mul(x, x);
+			if (x == one)
+				return false;
+			if (x == minus_one)
+				break;
 		}
-		return seed;
+
+		if (x != minus_one)
+			return false;
 	}
-};
 
-ostream& operator<<(ostream& os, const LNum& ln) {
-	return os << ln.to_str();
+	return true;
 }
 
 // Modular multiplicative inverse
@@ -679,6 +2541,7 @@ optional<LNum> chinese_remainder(vector<LNum> n, vector<LNum> a) {
 }
 
 LNum gcd(LNum a, LNum b) {
+	STATS_TIME(GCD, max(a.limbs(), b.limbs()));
 	while (b != 0) {
 		a %= b;
 		if (a == 0)
@@ -688,8 +2551,209 @@ LNum gcd(LNum a, LNum b) {
 	return a;
 }
 
+// Bernstein's batch GCD: result[i] = gcd(n_i, product of the other moduli), so every modulus that
+// shares a factor with another one gets a non-trivial divisor.
+// A product tree is built bottom-up, then P mod n² is pushed down it and gcd(n_i, (P mod n_i²) / n_i)
+// is taken at the leaves; every level is processed in parallel.
+// With spill_dir set, finished levels of the product tree go to files there and only two levels
+// are held in memory at a time.
+vector<LNum> batch_gcd(const vector<LNum>& moduli, const string& spill_dir = "") {
+	// Every call names its files with a number of its own within the process and a random_device word
+	// across processes, so calls sharing spill_dir or files left by a crashed run never collide
+	static atomic<uint64_t> calls{ 0 };
+	const string call_tag = to_string(calls.fetch_add(1)) + "_" + to_string(random_device()());
+	auto level_path = [&](size_t k) {
+		return spill_dir + "/batch_gcd_" + call_tag + "_level_" + to_string(k) + ".bin";
+	};
+
+	// Level files still on disk when batch_gcd leaves, by return or by exception, are removed
+	struct SpillFiles {
+		vector<string> paths;
+		~SpillFiles() {
+			for (const string& path : paths)
+				std::remove(path.c_str());
+		}
+	} spilled;
+
+	auto spill = [&](size_t k, vector<LNum>& level) {
+		ofstream file(level_path(k), ios::binary);
+		file.exceptions(ios::failbit | ios::badbit);
+		spilled.paths.push_back(level_path(k));
+		const uint64_t size = level.size();
+		file.write((const char*)&size, sizeof(size));
+		for (const LNum& x : level)
+			x.write(file);
+		vector<LNum>().swap(level);
+	};
+
+	auto restore = [&](size_t k) {
+		vector<LNum> level;
+		{
+			ifstream file(level_path(k), ios::binary);
+			file.exceptions(ios::failbit | ios::badbit);
+			uint64_t size = 0;
+			file.read((char*)&size, sizeof(size));
+			level.reserve(size);
+			for (uint64_t i = 0; i < size; ++i)
+				level.push_back(LNum::read(file));
+		}
+		std::remove(level_path(k).c_str());
+		return level;
+	};
+
+	auto for_each_index = [](size_t n, auto f) {
+		vector<size_t> indices(n);
+		iota(indices.begin(), indices.end(), 0);
+		for_each(std::execution::par, indices.begin(), indices.end(), f);
+	};
+
+	if (moduli.empty())
+		return {};
+
+	// tree[0] pairs up the moduli, tree[k] pairs up tree[k - 1], tree.back() is { P }
+	vector<vector<LNum>> tree;
+	for (const vector<LNum>* below = &moduli; below->size() > 1; below = &tree.back()) {
+		vector<LNum> level((below->size() + 1) / 2);
+		for_each_index(level.size(), [&](size_t i) {
+			level[i] = 2 * i + 1 < below->size() ? (*below)[2 * i] * (*below)[2 * i + 1] : (*below)[2 * i];
+		});
+		if (!spill_dir.empty() && !tree.empty())
+			spill(tree.size() - 1, tree.back());
+		tree.push_back(move(level));
+	}
+
+	vector<LNum> rems{ tree.empty() ? moduli[0] : tree.back()[0] };
+	for (int64_t k = (int64_t)tree.size() - 2; k >= 0; --k) {
+		vector<LNum> level = spill_dir.empty() ? move(tree[k]) : restore(k);
+		for_each_index(level.size(), [&](size_t i) {
+			level[i] = rems[i / 2] % (level[i] * level[i]);
+		});
+		rems.swap(level);
+	}
+
+	vector<LNum> res(moduli.size());
+	for_each_index(moduli.size(), [&](size_t i) {
+		res[i] = gcd(moduli[i], rems[i / 2] % (moduli[i] * moduli[i]) / moduli[i]);
+	});
+	return res;
+}
+
+// LRU cache of prime factorizations shared by ro_pollard, totient and mobius
+class FactorCache {
+	typedef list<pair<LNum, vector<LNum>>> Entries;
+
+	size_t capacity;
+	Entries entries; // most recently used first
+	unordered_map<LNum, Entries::iterator, LNumHasher> index;
+	mutex lock;
+
+public:
+	explicit FactorCache(size_t capacity) : capacity(capacity) {}
+
+	optional<vector<LNum>> find(const LNum& n) {
+		lock_guard<mutex> guard(lock);
+		auto it = index.find(n);
+		if (it == index.end()) {
+			STATS_COUNT(FACTOR_CACHE_MISSES, 1);
+			return nullopt;
+		}
+		STATS_COUNT(FACTOR_CACHE_HITS, 1);
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->second;
+	}
+
+	void insert(const LNum& n, const vector<LNum>& factors) {
+		lock_guard<mutex> guard(lock);
+		if (auto it = index.find(n); it != index.end()) {
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+		entries.emplace_front(n, factors);
+		index.emplace(n, entries.begin());
+		if (entries.size() > capacity) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+	}
+
+	void clear() {
+		lock_guard<mutex> guard(lock);
+		index.clear();
+		entries.clear();
+	}
+};
+
+FactorCache& factor_cache() {
+	static FactorCache cache(1 << 12);
+	return cache;
+}
+
+// Deterministic Miller–Rabin, these bases are enough for every 64-bit n
+bool is_prime(uint64_t n) {
+	if (n < 2) return false;
+	for (uint64_t p : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 }) {
+		if (n % p == 0)
+			return n == p;
+	}
+
+	uint64_t d = n - 1;
+	int s = 0;
+	while (d % 2 == 0) {
+		d /= 2;
+		s += 1;
+	}
+
+	const ModU64 mod(n);
+	for (uint64_t a : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 }) {
+		STATS_COUNT(MILLER_RABIN_ROUNDS, 1);
+		uint64_t x = mod.pow(a, d);
+		if (x == 1 || x == n - 1)
+			continue;
+
+		int r = 1;
+		for (; r < s; ++r) {
+			x = mod.mul(x, x);
+			if (x == n - 1)
+				break;
+		}
+
+		if (r == s)
+			return false;
+	}
+
+	return true;
+}
+
+uint64_t _ro_pollard(uint64_t n) {
+	if (n == 4) return 2;
+	const ModU64 mod(n);
+	auto f = [&mod](uint64_t x, uint64_t inc) { return mod.add(mod.mul(x, x), inc % mod.modulus()); };
+	uint64_t d = 1;
+
+	uint64_t x = 2;
+	uint64_t y = 2;
+	uint64_t inc = 1;
+
+	do {
+		STATS_COUNT(RHO_ITERATIONS, 1);
+		x = f(x, inc);
+		y = f(f(y, inc), inc);
+		STATS_COUNT(RHO_GCD_CALLS, x != y);
+		d = x == y ? 0 : std::gcd(x > y ? x - y : y - x, n);
+
+		if (d == 0) {
+			x = 2;
+			y = 2;
+			d = 1;
+			inc += 1;
+		}
+	} while (d == 1 || d == n);
+	return d;
+}
+
 LNum _ro_pollard(LNum n) {
-	auto f = [](LNum x, LNum n, LNum inc) { return (x * x + inc) % n; };
+	LimbPool::Scope scope;
+	auto f = [](LNum& x, const LNum& n, const LNum& inc) { x.sqr_add(x, inc) %= n; };
 	LNum d = 1;
 	if (n == 4) return 2;
 
@@ -698,9 +2762,11 @@ LNum _ro_pollard(LNum n) {
 	LNum inc = 1;
 
 	do {
-		x = f(x, n, inc);
-		y = f(y, n, inc);
-		y = f(y, n, inc);
+		STATS_COUNT(RHO_ITERATIONS, 1);
+		f(x, n, inc);
+		f(y, n, inc);
+		f(y, n, inc);
+		STATS_COUNT(RHO_GCD_CALLS, x != y);
 		d = x == y ? 0 : gcd(LNum::abs_sub(x, y), n);
 
 		if (d == 0) {
@@ -714,8 +2780,39 @@ LNum _ro_pollard(LNum n) {
 }
 
 // 1. https://ru.wikipedia.org/wiki/%D0%A0%D0%BE-%D0%B0%D0%BB%D0%B3%D0%BE%D1%80%D0%B8%D1%82%D0%BC_%D0%9F%D0%BE%D0%BB%D0%BB%D0%B0%D1%80%D0%B4%D0%B0
+vector<uint64_t> ro_pollard(uint64_t n) {
+	const LNum key = n;
+	if (auto cached = factor_cache().find(key)) {
+		vector<uint64_t> res;
+		for (const LNum& factor : *cached)
+			res.push_back(factor.to_int());
+		return res;
+	}
+	if (n == 1 || is_prime(n)) {
+		factor_cache().insert(key, { key });
+		return { n };
+	}
+
+	uint64_t left = _ro_pollard(n);
+	uint64_t right = n / left;
+	auto res1 = ro_pollard(left);
+	auto res2 = ro_pollard(right);
+
+	res1.insert(res1.end(), res2.begin(), res2.end());
+	factor_cache().insert(key, vector<LNum>(res1.begin(), res1.end()));
+	return res1;
+}
+
 vector<LNum> ro_pollard(LNum n) {
+	if (n.fits_u64()) {
+		auto factors = ro_pollard(n.to_int());
+		return vector<LNum>(factors.begin(), factors.end());
+	}
+	if (auto cached = factor_cache().find(n)) {
+		return *cached;
+	}
 	if (n.is_prime(5)) {
+		factor_cache().insert(n, { n });
 		return { n };
 	}
 
@@ -725,28 +2822,69 @@ vector<LNum> ro_pollard(LNum n) {
 	auto res2 = ro_pollard(right);
 
 	res1.insert(res1.end(), res2.begin(), res2.end());
+	factor_cache().insert(n, res1);
 	return res1;
 }
 
+uint64_t isqrt(uint64_t x) {
+	uint64_t r = uint64_t(sqrtl(ldouble(x)));
+	while (r > 0 && (r > UINT32_MAX || r * r > x)) --r;
+	while (r < UINT32_MAX && (r + 1) * (r + 1) <= x) ++r;
+	return r;
+}
+
 // 2. https://en.wikipedia.org/wiki/Baby-step_giant-step
+uint64_t babystep_giantstep(uint64_t g, uint64_t h, uint64_t p) {
+	const ModU64 mod(p);
+	uint64_t m = isqrt(p);
+	if (p - m * m > 0) m += 1;
+
+	auto table = unordered_map<uint64_t, uint64_t>();
+	uint64_t e = 1 % p;
+	for (uint64_t i = 0; i < m; i += 1) {
+		STATS_COUNT(BSGS_TABLE_INSERTS, 1);
+		table[e] = i;
+		e = mod.mul(e, g);
+	}
+
+	const uint64_t factor = mod.pow(g, p - m - 1);
+	e = h;
+	for (uint64_t i = 0; i < m; i += 1) {
+		STATS_COUNT(BSGS_GIANT_STEPS, 1);
+		if (auto it = table.find(e); it != table.end() && it->second != 0) {
+			return i * m + it->second;
+		}
+		e = mod.mul(e, factor);
+	}
+
+	return 0;
+}
+
 LNum babystep_giantstep(LNum g, LNum h, LNum p) {
+	if (p.fits_u64())
+		return babystep_giantstep(g % p.to_int(), h.fits_u64() ? h.to_int() : h % p.to_int(), p.to_int());
+
 	LNum m = LNum::sqrt(p);
 	if (p - m * m > 0) m += 1;
 
 	auto table = unordered_map<LNum, LNum, LNumHasher>();
 	LNum e = 1;
 	for (LNum i = 0; i < m; i += 1) {
+		STATS_COUNT(BSGS_TABLE_INSERTS, 1);
 		table[e] = i;
-		e = (e * g) % p;
+		e *= g;
+		e %= p;
 	}
 
 	const LNum factor = g.pow_mod(p - m - 1, p);
 	e = h;
 	for (LNum i = 0; i < m; i += 1) {
+		STATS_COUNT(BSGS_GIANT_STEPS, 1);
 		if (auto it = table.find(e); it != table.end() && it->second != 0) {
 			return { i * m + it->second };
 		}
-		e = (e * factor) % p;
+		e *= factor;
+		e %= p;
 	}
 
 	return 0;
@@ -760,6 +2898,14 @@ vector<T> unique(vector<T> v) {
 }
 
 // 3. https://stackoverflow.com/a/52263174/8390594
+uint64_t totient(uint64_t n) {
+	if (n == 1) return 1;
+	for (uint64_t factor : unique(ro_pollard(n))) {
+		n -= n / factor;
+	}
+	return n;
+}
+
 LNum totient(LNum n) {
 	if (n == 1) return 1;
 	for (LNum& factor : unique(ro_pollard(n))) {
@@ -768,59 +2914,205 @@ LNum totient(LNum n) {
 	return n;
 }
 
-// 3. https://www.geeksforgeeks.org/program-mobius-function/
+// 3. μ(n) from the prime factorization: 0 if a prime repeats, otherwise (-1)^(number of primes)
+template <typename T>
+int16_t mobius_of(vector<T> factors) {
+	sort(factors.begin(), factors.end());
+	if (adjacent_find(factors.begin(), factors.end()) != factors.end())
+		return 0;
+	return factors.size() % 2 ? -1 : 1;
+}
+
+int16_t mobius(uint64_t n) {
+	if (n == 1) return 1;
+	return mobius_of(ro_pollard(n));
+}
+
 int16_t mobius(LNum n) {
-	LNum p = 0;
+	if (n == 1) return 1;
+	return mobius_of(ro_pollard(n));
+}
 
-	if (n % 2 == 0) {
-		n = n / 2;
-		p += 1;
+// 3. Smallest prime factor, φ and μ for every n in [lo, hi)
+struct SieveTable {
+	uint64_t lo, hi;
+	vector<uint64_t> spf;
+	vector<uint64_t> phi;
+	vector<int8_t> mu;
+};
 
-		if (n % 2 == 0)
-			return 0;
-	}
+// The same tables for one segment [start, end), index i holds n = start + i
+struct SieveSegment {
+	uint64_t start, end;
+	vector<uint64_t> spf;
+	vector<uint64_t> phi;
+	vector<int8_t> mu;
+};
 
-	const LNum ii = LNum::sqrt(n);
-	for (LNum i = 3; i <= ii; i = i + 2) {
-		if (n % i == 0) {
-			n = n / i;
-			p += 1;
+// Sieves [lo, hi) in segments of segment_size numbers and hands each finished segment to visit(const SieveSegment&).
+// Segments run in parallel, so visit is called concurrently and in no particular order. Only the segments in
+// flight are held in memory, one per worker thread, however wide the range is.
+template <typename Visit>
+void sieve_segments(uint64_t lo, uint64_t hi, Visit visit, uint64_t segment_size = 1 << 15) {
+	assert(lo <= hi);
+	const uint64_t root = hi > 0 ? isqrt(hi - 1) : 0;
+	vector<bool> composite(root + 1);
+	vector<uint64_t> primes;
+	for (uint64_t i = 2; i <= root; ++i) {
+		if (composite[i])
+			continue;
+		primes.push_back(i);
+		for (uint64_t j = i * i; j <= root; j += i)
+			composite[j] = true;
+	}
+
+	vector<uint64_t> segments;
+	for (uint64_t start = lo; start < hi; start += min(segment_size, hi - start))
+		segments.push_back(start);
+
+	for_each(std::execution::par, segments.begin(), segments.end(), [&](uint64_t start) {
+		const uint64_t end = start + min(segment_size, hi - start);
+		SieveSegment seg{ start, end, vector<uint64_t>(end - start), vector<uint64_t>(end - start), vector<int8_t>(end - start) };
+		vector<uint64_t> rest(end - start);
+		for (uint64_t n = start; n < end; ++n) {
+			rest[n - start] = n;
+			seg.phi[n - start] = n;
+			seg.mu[n - start] = n == 0 ? 0 : 1;
+		}
 
-			if (n % i == 0)
-				return 0;
+		for (uint64_t p : primes) {
+			if (p * p >= end)
+				break;
+			for (uint64_t n = max(p * p, (start + p - 1) / p * p); n < end; n += p) {
+				const uint64_t i = n - start;
+				if (seg.spf[i] == 0)
+					seg.spf[i] = p;
+				seg.phi[i] -= seg.phi[i] / p;
+				seg.mu[i] = -seg.mu[i];
+				rest[i] /= p;
+				if (rest[i] % p == 0) {
+					seg.mu[i] = 0;
+					do rest[i] /= p; while (rest[i] % p == 0);
+				}
+			}
 		}
-	}
 
-	return (p % 2) ? 1 : -1;
+		// Whatever is left is 1 or a single prime above √n
+		for (uint64_t n = max<uint64_t>(start, 2); n < end; ++n) {
+			const uint64_t i = n - start;
+			if (rest[i] > 1) {
+				if (seg.spf[i] == 0)
+					seg.spf[i] = rest[i];
+				seg.phi[i] -= seg.phi[i] / rest[i];
+				seg.mu[i] = -seg.mu[i];
+			}
+		}
+		if (start <= 1 && 1 < end)
+			seg.spf[1 - start] = 1;
+
+		visit(as_const(seg));
+	});
+}
+
+// Whole-range tables, 17 bytes per number; use sieve_segments for ranges that don't fit in memory
+SieveTable segmented_sieve(uint64_t lo, uint64_t hi, uint64_t segment_size = 1 << 15) {
+	assert(lo <= hi);
+	SieveTable table{ lo, hi, vector<uint64_t>(hi - lo), vector<uint64_t>(hi - lo), vector<int8_t>(hi - lo) };
+	sieve_segments(lo, hi, [&](const SieveSegment& seg) {
+		const uint64_t offset = seg.start - lo;
+		copy(seg.spf.begin(), seg.spf.end(), table.spf.begin() + offset);
+		copy(seg.phi.begin(), seg.phi.end(), table.phi.begin() + offset);
+		copy(seg.mu.begin(), seg.mu.end(), table.mu.begin() + offset);
+	}, segment_size);
+	return table;
 }
 
 // 4. https://en.wikipedia.org/wiki/Jacobi_symbol
-int16_t jacobi(LNum a, LNum n) {
-	assert(n > a&& a > 0 && n % 2 == 1);
+// Binary algorithm: only shifts and subtractions of odd numbers, no division inside the loop
+int16_t _jacobi(uint64_t a, uint64_t n) {
 	a %= n;
 	int8_t res = 1;
 	while (a != 0) {
-		while (a % 2 == 0) {
-			a /= 2;
-			LNum r = n % 8;
-			if (r == 3 || r == 5) res = -res; // 9: (2a | n) = -(a | n) if n = 3, 5 (mod 8) else (a | n)
+		uint64_t zeros = 0;
+		for (; a % 2 == 0; a /= 2) ++zeros;
+		const uint64_t r = n % 8;
+		if (zeros % 2 == 1 && (r == 3 || r == 5)) res = -res; // 9: (2a | n) = -(a | n) if n = 3, 5 (mod 8) else (a | n)
+		if (a < n) {
+			swap(a, n);
+			if (a % 4 == 3 && n % 4 == 3)
+				res = -res; // 6: (a | n)  = -(n | a) if n = a = 3 (mod 4) eles (n | a)
 		}
-		swap(a, n);
-		if (a % 4 == 3 && n % 4 == 3)
-			res = -res; // 6: (a | n)  = -(n | a) if n = a = 3 (mod 4) eles (n | a)
-		a %= n;
+		a -= n;
 	}
 	if (n == 1) return res;
 	else return 0;
 }
 
-// 4. Legendre symbol. Returns 1, 0, or p-1
-LNum legendre1(LNum a, LNum p) {
-	LNum res = a.pow_mod((p - 1) / 2, p);
-	// assert(res == legendre2(a, p));
+int16_t _jacobi(LNum a, LNum n) {
+	a %= n;
+	int8_t res = 1;
+	while (!a.is_zero()) {
+		if (a.fits_u64() && n.fits_u64())
+			return res * _jacobi(a.to_int(), n.to_int());
+		const uint64_t zeros = a.count_trailing_zeros();
+		a >>= zeros;
+		const uint64_t r = n % 8;
+		if (zeros % 2 == 1 && (r == 3 || r == 5)) res = -res;
+		if (a < n) {
+			swap(a, n);
+			if (a % 4 == 3 && n % 4 == 3)
+				res = -res;
+		}
+		a -= n;
+	}
+	if (n == 1) return res;
+	else return 0;
+}
+
+int16_t jacobi(uint64_t a, uint64_t n) {
+	assert(n > a&& a > 0 && n % 2 == 1);
+	return _jacobi(a, n);
+}
+
+int16_t jacobi(LNum a, LNum n) {
+	assert(n > a&& a > 0 && n % 2 == 1);
+	return _jacobi(move(a), move(n));
+}
+
+// 4. (values[i] | n) for every i, evaluated in parallel
+vector<int16_t> jacobi_many(const vector<LNum>& values, const LNum& n) {
+	assert(n.is_odd());
+	vector<int16_t> res(values.size());
+	if (n.fits_u64()) {
+		const uint64_t n_ = n.to_int();
+		transform(std::execution::par, values.begin(), values.end(), res.begin(), [n_](const LNum& a) {
+			return _jacobi(a % n_, n_);
+		});
+	}
+	else {
+		transform(std::execution::par, values.begin(), values.end(), res.begin(), [&n](const LNum& a) {
+			return _jacobi(a, n);
+		});
+	}
 	return res;
 }
 
+// 4. Legendre symbol for an odd prime p, taken from the Jacobi symbol. Returns 1, 0, or p-1
+uint64_t legendre1(uint64_t a, uint64_t p) {
+	if (p % 2 == 0)
+		return ModU64(p).pow(a, (p - 1) / 2);
+	const int16_t res = _jacobi(a, p);
+	return res < 0 ? p - 1 : res;
+}
+
+LNum legendre1(LNum a, LNum p) {
+	if (p.fits_u64()) return legendre1(a % p.to_int(), p.to_int());
+	if (!p.is_odd())
+		return a.pow_mod((p - 1) >> 1, p);
+	const int16_t res = _jacobi(move(a), p);
+	return res < 0 ? p - 1 : LNum(res);
+}
+
 tuple<LNum, LNum> mul(tuple<LNum, LNum> aa, tuple<LNum, LNum> bb, LNum p, LNum finalOmega) {
 	return make_tuple(
 		(get<0>(aa) * get<0>(bb) + get<1>(aa) * get<1>(bb) * finalOmega) % p,
@@ -829,16 +3121,68 @@ tuple<LNum, LNum> mul(tuple<LNum, LNum> aa, tuple<LNum, LNum> bb, LNum p, LNum f
 }
 
 // 5. https://rosettacode.org/wiki/Cipolla%27s_algorithm
+optional<tuple<LNum, LNum>> chipolli(uint64_t n, uint64_t p) {
+	const ModU64 mod(p);
+	if (legendre1(n, p) != 1) {
+		return make_tuple(0, 0);
+	}
+
+	uint64_t a = 0;
+	uint64_t omega2 = 0;
+	while (true) {
+		omega2 = mod.sub(mod.mul(a, a), n % p);
+		if (legendre1(omega2, p) == p - 1) {
+			break;
+		}
+		a += 1;
+	}
+
+	// (x₀ + x₁ω)(y₀ + y₁ω) with ω² = omega2
+	auto mul = [&mod, omega2](pair<uint64_t, uint64_t> aa, pair<uint64_t, uint64_t> bb) {
+		return make_pair(
+			mod.add(mod.mul(aa.first, bb.first), mod.mul(mod.mul(aa.second, bb.second), omega2)),
+			mod.add(mod.mul(aa.first, bb.second), mod.mul(bb.first, aa.second))
+		);
+	};
+
+	// Step 2: Compute power
+	pair<uint64_t, uint64_t> r = { 1 % p, 0 };
+	pair<uint64_t, uint64_t> s = { a % p, 1 % p };
+	for (uint64_t nn = ((p + 1) / 2) % p; nn > 0; nn /= 2) {
+		if (nn % 2 == 1) {
+			r = mul(r, s);
+		}
+		s = mul(s, s);
+	}
+
+	// Step 3: Check x in Fp
+	if (r.second != 0) {
+		return nullopt;
+	}
+
+	// Step 5: Check x * x = n
+	if (mod.mul(r.first, r.first) != n) {
+		return nullopt;
+	}
+
+	// Step 4: Solutions
+	return make_tuple(r.first, p - r.first);
+}
+
 optional<tuple<LNum, LNum>> chipolli(LNum n, LNum p) {
+	if (p.fits_u64() && n.fits_u64()) {
+		return chipolli(n.to_int(), p.to_int());
+	}
 	if (legendre1(n, p) != 1) {
 		return make_tuple(0, 0);
 	}
 
+	const LNum p_1 = p - 1;
 	LNum a = 0;
 	LNum omega2 = 0;
 	while (true) {
 		omega2 = (a * a + p - n) % p;
-		if (legendre1(omega2, p) == p - 1) {
+		if (legendre1(omega2, p) == p_1) {
 			break;
 		}
 		a += 1;
@@ -847,13 +3191,13 @@ optional<tuple<LNum, LNum>> chipolli(LNum n, LNum p) {
 	// Step 2: Compute power
 	tuple<LNum, LNum> r = make_tuple(1, 0);
 	tuple<LNum, LNum> s = make_tuple(a, 1);
-	LNum nn = ((p + 1) / 2) % p;
-	while (nn > 0) {
-		if (nn % 2 == 1) {
+	LNum nn = ((p + 1) >> 1) % p;
+	while (!nn.is_zero()) {
+		if (nn.is_odd()) {
 			r = mul(r, s, p, omega2);
 		}
 		s = mul(s, s, p, omega2);
-		nn /= 2;
+		nn >>= 1;
 	}
 
 	// Step 3: Check x in Fp
@@ -901,7 +3245,38 @@ string decrypt(vector<LNum> en_msg, LNum p, LNum key, LNum q) {
 	return dr_msg;
 }
 
+// Same as encrypt, with both exponentiations done in a fixed Bits-wide group
+template <size_t Bits>
+tuple<vector<LNum>, LNum> encrypt(string msg, LNum q, LNum h, LNum g) {
+	vector<LNum> en_msg(msg.size());
+
+	LNum k = gen_key(q);
+	const FixedNum<Bits> q_(q), k_(k);
+	LNum s = FixedNum<Bits>(h).pow_mod(k_, q_).to_lnum();
+	LNum p = FixedNum<Bits>(g).pow_mod(k_, q_).to_lnum();
+
+	cout << "g^k used : " << p << endl;
+	cout << "g^ak used : " << s << endl;
+	for (size_t i = 0; i < msg.size(); ++i) {
+		en_msg[i] = s * msg[i];
+	}
+
+	return make_tuple(en_msg, p);
+}
+
+template <size_t Bits>
+string decrypt(vector<LNum> en_msg, LNum p, LNum key, LNum q) {
+	string dr_msg;
+	LNum h = FixedNum<Bits>(p).pow_mod(FixedNum<Bits>(key), FixedNum<Bits>(q)).to_lnum();
+	for (size_t i = 0; i < en_msg.size(); ++i) {
+		dr_msg += (en_msg[i] / h).to_int();
+	}
+	return dr_msg;
+}
+
 // ⁰¹²³⁴⁵⁶⁷⁸⁹
+// Benchmark.cpp includes this file with BIGNUM_NO_MAIN defined
+#ifndef BIGNUM_NO_MAIN
 int main() {
 	cout << boolalpha;
 
@@ -915,8 +3290,8 @@ int main() {
 	LNum h = g.pow_mod(key, q);
 	vector<LNum> en_msg;
 	LNum p = 0;
-	tie(en_msg, p) = encrypt(message, q, h, g);
-	cout << "\tDecripted message: " << decrypt(en_msg, p, key, q) << endl;
+	tie(en_msg, p) = encrypt<256>(message, q, h, g);
+	cout << "\tDecripted message: " << decrypt<256>(en_msg, p, key, q) << endl;
 
 	// Tests for LNum class
 	cout << "24523748428⁶⁵⁰⁰⁰⁰⁰ (mod 98723459723):\n\t";
@@ -947,6 +3322,22 @@ int main() {
 	cout << "mobius(1234891):\n\t";
 	cout << mobius(1234891) << endl;
 
+	// Segmented sieve test
+	cout << "totient(n) for n in [1000000, 1000010):\n\t";
+	const SieveTable table = segmented_sieve(1000000, 1000010);
+	for (uint64_t phi : table.phi) {
+		cout << phi << ' ';
+	}
+	cout << endl;
+
+	// Mertens function M(10⁶) = Σ μ(n) over n <= 10⁶, one segment at a time
+	cout << "mertens(1000000):\n\t";
+	atomic<int64_t> mertens = 0;
+	sieve_segments(1, 1000001, [&](const SieveSegment& seg) {
+		mertens += accumulate(seg.mu.begin(), seg.mu.end(), int64_t(0));
+	});
+	cout << mertens << endl;
+
 	// Legendre symbol test
 	cout << "legendre1(30, 109):\n\t";
 	cout << legendre1(30, 109) << endl;
@@ -969,4 +3360,11 @@ int main() {
 	vector<LNum> a = { 16, 22, 30 };
 	auto solution = chinese_remainder(n, a);
 	cout << (solution.has_value() ? solution.value().to_str() : "No solution") << endl;
+
+	// Batch GCD
+	cout << "batch_gcd(10403, 10807, 12317, 12319):\n\t";
+	for (LNum& d : batch_gcd({ 10403, 10807, 12317, 12319 }))
+		cout << d << ' ';
+	cout << endl;
 }
+#endif